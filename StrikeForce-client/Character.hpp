@@ -26,35 +26,19 @@ SOFTWARE.
 
 namespace Environment::Character{
 
-	int compute_damage(int x, int y){
-    	int l = 0, r = x + 1, z = 2;
-    	while(1 < y){
-	        y >>= 1;
-    	    ++z;
-    	}
-	    while(r - l > 1){
-    	    int mid = (l + r) >> 1, tmp = x;
-        	for(int i = 0; i < z && mid; ++i)
-            	tmp /= mid;
-	        	if(tmp)
-    	        	l = mid;
-        		else
-            		r = mid;
-    	}
-    	return l;
-	}
+	using Environment::Item::compute_damage;
 
 	const int wdx[4] = {1, 0, -1, 0}, wdy[4] = {0, 1, 0, -1};
 
 	class Backpack{
 
-	using pci = std::pair<Environment::Item::ConsumableItem, int>;
+	using pci = std::pair<Environment::Item::item_ref<Environment::Item::ConsumableItem>, int>;
 
-	using pbii = std::pair<Environment::Item::Bullet, std::pair<int, int>>;
+	using pbii = std::pair<Environment::Item::item_ref<Environment::Item::Bullet>, std::pair<int, int>>;
 
 	using pii = std::pair<int, int>;
 
-	using pwi = std::pair<Environment::Item::Weapon, int>;
+	using pwi = std::pair<Environment::Item::item_ref<Environment::Item::Weapon>, int>;
 
 	private:
 		int capacity, lvl, vol, price;
@@ -81,11 +65,11 @@ namespace Environment::Character{
 			portal_ind = -1;
 			vec = ind = -1;
 			for(int i = 0; i < 4; ++i)
-				list_cons[i] = pci{Environment::Item::cons[i], 0};
+				list_cons[i] = pci{i, 0};
 			for(int i = 0; i < 4; ++i)
-				list_throw[i] = pbii{Environment::Item::throw_[i], pii{1, 0}};
+				list_throw[i] = pbii{i, pii{1, 0}};
 			for(int i = 0; i < 8; ++i)
-				list_w[i] = pwi{Environment::Item::w[i], 0};
+				list_w[i] = pwi{i, 0};
 			return;
 		}
 
@@ -113,10 +97,10 @@ namespace Environment::Character{
 			return lvl;
 		}
 
-		void upgrade(){
-			capacity += 200;
-			price += 200;
-			++lvl;
+		void upgrade(int k = 1){
+			capacity += 200 * k;
+			price += 200 * k;
+			lvl += k;
 			return;
 		}
 
@@ -159,9 +143,9 @@ namespace Environment::Character{
 		    return;
 		}
 
-		void increase_def(){
-		    ++def_blocks;
-		    ++def_portals;
+		void increase_def(int k = 1){
+		    def_blocks += k;
+		    def_portals += k;
 		    return;
 		}
 
@@ -222,26 +206,59 @@ namespace Environment::Character{
 		}
 	};
 
+	// fields read by every combat pass. a character stored in a pool points into the pool's packed
+	// array of these, any other character points to its own copy
+	struct combat_state{
+		int Hp = 0, mindamage = 0, stamina = 0, way = 0, team = 0;
+		int cor[3] = {0, 0, 0};
+	};
+
 	class Character{
 
 	protected:
+		combat_state own, *hs = &own;
 		std::string name;
-		int Hp, mindamage, mindamage_def, def_Hp;
-		std::vector<int> cor = {0, 0, 0};
+		int mindamage_def, def_Hp;
 
 	public:
+		Character() = default;
+
+		Character(const Character &c): own(*c.hs), name(c.name), mindamage_def(c.mindamage_def), def_Hp(c.def_Hp){}
+
+		Character& operator=(const Character &c){
+			*hs = *c.hs;
+			name = c.name;
+			mindamage_def = c.mindamage_def;
+			def_Hp = c.def_Hp;
+			return *this;
+		}
+
+		void bind(combat_state* p){
+			*p = *hs;
+			hs = p;
+			return;
+		}
+
+		const combat_state& state() const{
+			return *hs;
+		}
+
+		bool pooled() const{
+			return hs != &own;
+		}
+
 		void set_Hp(int Hp){
-			this->Hp = Hp;
+			hs->Hp = Hp;
 			return;
 		}
 
 		int get_Hp() const{
-			return Hp;
+			return hs->Hp;
 		}
 
 		void hit(const Environment::Item::Bullet &b){
-			Hp -= b.get_damage();
-			mindamage += b.get_effect();
+			hs->Hp -= b.get_damage();
+			hs->mindamage += b.get_effect();
 			return;
 		}
 
@@ -255,21 +272,21 @@ namespace Environment::Character{
 		}
 
 		std::vector<int> get_cor() const{
-			return cor;
+			return {hs->cor[0], hs->cor[1], hs->cor[2]};
 		}
 
 		void set_cor(const std::vector<int> &c){
-			cor = c;
+			hs->cor[0] = c[0], hs->cor[1] = c[1], hs->cor[2] = c[2];
 			return;
 		}
 
 		void set_mindamage(int mindamage){
-			this->mindamage = mindamage;
+			hs->mindamage = mindamage;
 			return;
 		}
 
 		int get_mindamage() const{
-			return mindamage;
+			return hs->mindamage;
 		}
 
 		int get_mindamage_def() const{
@@ -286,12 +303,47 @@ namespace Environment::Character{
 		}
 	};
 
+	class Human;
+
+	// compute_damage(key, 1) packed with its key in one word, so observation threads reading
+	// the same human never see a key with the value of another
+	struct punch_cache{
+		mutable std::atomic<unsigned long long> word{~0ull};
+
+		punch_cache() = default;
+
+		punch_cache(const punch_cache &o): word(o.word.load(std::memory_order_relaxed)){}
+
+		punch_cache& operator=(const punch_cache &o){
+			word.store(o.word.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+
+		int get(int key) const{
+			unsigned long long w = word.load(std::memory_order_relaxed);
+			if((int)(w >> 32) != key){
+				w = (unsigned long long)(unsigned)key << 32 | (unsigned)compute_damage(key, 1);
+				word.store(w, std::memory_order_relaxed);
+			}
+			return (int)(unsigned)w;
+		}
+	};
+
+	// humans that received an agent, lets a match reset free them without visiting every slot
+	std::vector<Human*> with_agent;
+
 	class Human: public Character{
 	protected:
 
 		bool rnpc, active_agent = false;
-		int level_solo, level_timer, level_squad, money, stamina, def_stamina;
-		int rate_solo, rate_timer, rate_squad, rate, way, team, kills = 0, damage = 0, effect = 0;
+		int level_solo, level_timer, level_squad, money, def_stamina;
+		int rate_solo, rate_timer, rate_squad, rate, kills = 0, damage = 0, effect = 0;
+		punch_cache punch_base;
+
+		// compute_damage(mindamage_def, 1), recomputed only when the profile changes
+		int base_punch() const{
+			return punch_base.get(mindamage_def);
+		}
 	
 	public:
 		Agent* agent;
@@ -323,6 +375,8 @@ namespace Environment::Character{
 		}
 
 		void set_agent_active(){
+			if(!active_agent)
+				with_agent.push_back(this);
 			active_agent = true;
 		}
 
@@ -361,27 +415,27 @@ namespace Environment::Character{
 		}
 
 		void set_team(int team){
-			this->team = team;
+			hs->team = team;
 			return;
 		}
 
 		int get_team() const{
-			return team;
+			return hs->team;
 		}
 
 		void claim_chest(const Environment::Item::ConsumableItem &c){
-			stamina += c.get_stamina();
-			Hp += c.get_Hp();
-			mindamage += c.get_effect();
+			hs->stamina += c.get_stamina();
+			hs->Hp += c.get_Hp();
+			hs->mindamage += c.get_effect();
 			return;
 		}
 
-		bool use(const Environment::Item::ConsumableItem &c){
+		bool use(const Environment::Item::item_ref<Environment::Item::ConsumableItem> &c){
 			if(backpack.vec || backpack.list_cons[backpack.ind].second < 1)
 				return false;
-			stamina += c.get_stamina();
-			Hp += c.get_Hp();
-			mindamage += c.get_effect();
+			hs->stamina += c.get_stamina();
+			hs->Hp += c.get_Hp();
+			hs->mindamage += c.get_effect();
 			if((--backpack.list_cons[backpack.ind].second) < 1)
 				backpack.vec = -1;
             backpack.set_vol(backpack.get_vol() - c.get_vol());
@@ -390,54 +444,59 @@ namespace Environment::Character{
 
 		bool punch(Environment::Item::Bullet &b){
 			Environment::Item::Weapon p;
-			p.ready(std::max(compute_damage(mindamage_def, 1), mindamage), 0, 1);
-			std::vector<int> cor_ = {cor[0], cor[1] + wdx[way - 1], cor[2] + wdy[way - 1]};
-			b.shot(cor_, way, p, (uintptr_t)this);
+			p.ready(std::max(base_punch(), hs->mindamage), 0, 1);
+			std::vector<int> cor_ = {hs->cor[0], hs->cor[1] + wdx[hs->way - 1], hs->cor[2] + wdy[hs->way - 1]};
+			b.shot(cor_, hs->way, p, (uintptr_t)this);
 			return true;
 		}
 
 		bool shot_it(Environment::Item::Bullet &b){
 			Environment::Item::Weapon w = backpack.list_w[backpack.ind].first;
-			if(stamina + w.get_stamina() < 0)
+			if(hs->stamina + w.get_stamina() < 0)
 				return false;
-			stamina += w.get_stamina();
-			w.set_damage(std::max(compute_damage(w.get_damage(), w.get_range()), w.get_damage() + mindamage));
-			std::vector<int> cor_ = {cor[0], cor[1] + wdx[way - 1], cor[2] + wdy[way - 1]};
-			b.shot(cor_, way, w, (uintptr_t)this);
+			hs->stamina += w.get_stamina();
+			w.set_damage(std::max(backpack.list_w[backpack.ind].first.get_power(), w.get_damage() + hs->mindamage));
+			std::vector<int> cor_ = {hs->cor[0], hs->cor[1] + wdx[hs->way - 1], hs->cor[2] + wdy[hs->way - 1]};
+			b.shot(cor_, hs->way, w, (uintptr_t)this);
 			return true;
 		}
 
 		bool throw_it(Environment::Item::Bullet &b){
 			b = backpack.list_throw[backpack.ind].first;
-			b.set_damage(std::max(b.get_damage(), b.get_damage() + mindamage));
-			if(stamina + b.get_stamina() < 0)
+			b.set_damage(std::max(b.get_damage(), b.get_damage() + hs->mindamage));
+			if(hs->stamina + b.get_stamina() < 0)
 				return false;
 			if(backpack.list_throw[backpack.ind].second.second < 1){
 				backpack.vec = -1;
 				return false;
 			}
-			stamina += b.get_stamina();
+			hs->stamina += b.get_stamina();
 			--backpack.list_throw[backpack.ind].second.second;
 			if(backpack.list_throw[backpack.ind].second.second < 1)
 				backpack.vec = -1;
-			std::vector<int> cor_ = {cor[0], cor[1] + wdx[way - 1], cor[2] + wdy[way - 1]};
-			b.shot(cor_, way, b, (uintptr_t)this);
+			std::vector<int> cor_ = {hs->cor[0], hs->cor[1] + wdx[hs->way - 1], hs->cor[2] + wdy[hs->way - 1]};
+			b.shot(cor_, hs->way, b, (uintptr_t)this);
 			backpack.set_vol(backpack.get_vol() - b.get_vol());
 			return true;
 		}
 
 		std::vector<int> get_damage_effect() const{
+			auto [damage, effect] = damage_effect();
+			return {damage, effect};
+		}
+
+		std::pair<int, int> damage_effect() const{
 		    int vec = backpack.vec;
-		    int dmg = std::max(compute_damage(mindamage_def, 1), mindamage);
+		    int dmg = std::max(base_punch(), hs->mindamage);
             if(vec == 1){
                 auto b = &backpack.list_throw[backpack.ind].first;
-                if(0 <= stamina + b->get_stamina())
-                    return {std::max({b->get_damage(), b->get_damage() + mindamage, dmg}), b->get_effect()};
+                if(0 <= hs->stamina + b->get_stamina())
+                    return {std::max({b->get_damage(), b->get_damage() + hs->mindamage, dmg}), b->get_effect()};
             }
             if(vec == 2){
                 auto w = &backpack.list_w[backpack.ind].first;
-                if(0 <= stamina + w->get_stamina())
-                    return {std::max({compute_damage(w->get_damage(), w->get_range()), w->get_damage() + mindamage, dmg}), w->get_effect()};
+                if(0 <= hs->stamina + w->get_stamina())
+                    return {std::max({w->get_power(), w->get_damage() + hs->mindamage, dmg}), w->get_effect()};
             }
             return {dmg, 0};
 		}
@@ -514,7 +573,7 @@ namespace Environment::Character{
 			sscanf(buffer, "%d %d %d", &def_Hp, &mindamage_def, &def_stamina);
 			for(int _ = 0; _ < 3; ++_)
 				scroll(buffer);
-			Hp = def_Hp, mindamage = mindamage_def, stamina = def_stamina;
+			hs->Hp = def_Hp, hs->mindamage = mindamage_def, hs->stamina = def_stamina;
 			sscanf(buffer, "%d %d %d", &level_solo, &level_timer, &level_squad);
 			for(int _ = 0; _ < 3; ++_)
                 scroll(buffer);
@@ -533,36 +592,21 @@ namespace Environment::Character{
 				scroll(buffer);
 				sscanf(buffer, "%d", &backpack.list_throw[i].second.second);
 				scroll(buffer);
-				for(int j = 0; j + 1 < backpack.list_throw[i].second.first; ++j)
-					backpack.list_throw[i].first.upgrade();
+				backpack.list_throw[i].first.set_upgrades(backpack.list_throw[i].second.first - 1);
 				backpack.set_vol(backpack.get_vol() + backpack.list_throw[i].second.second * backpack.list_throw[i].first.get_vol());
 			}
 			for(int i = 0; i < 8; ++i){
 				sscanf(buffer, "%d", &backpack.list_w[i].second);
 				scroll(buffer);
-				for(int j = 0; j < backpack.list_w[i].second; ++j)
-					backpack.list_w[i].first.upgrade();
+				backpack.list_w[i].first.set_upgrades(backpack.list_w[i].second);
 				backpack.set_vol(backpack.get_vol() + backpack.list_w[i].second * backpack.list_w[i].first.get_vol());
 			}
-			int k, k1;
+			int k;
 			sscanf(buffer, "%d", &k);
-			while(--k)
-				backpack.upgrade();
-			k1 = k = level_solo;
-			level_solo = 1;
-			while(--k)
-				level_solo_up();
-			level_solo = k1;
-			k1 = k = level_timer;
-			level_timer = 1;
-			while(--k)
-				level_timer_up();
-			level_timer = k1;
-			k1 = k = level_squad;
-			level_squad = 1;
-			while(--k)
-				level_squad_up();
-			level_squad = k1;
+			backpack.upgrade(k - 1);
+			levels_up(1, level_solo);
+			levels_up(1, level_timer);
+			levels_up(1, level_squad);
 			backpack.back_tmp();
 			return;
 		}
@@ -574,7 +618,7 @@ namespace Environment::Character{
 			file >> name;
 			file >> def_Hp >> mindamage_def >> def_stamina;
 			
-			Hp = def_Hp, mindamage = mindamage_def, stamina = def_stamina;
+			hs->Hp = def_Hp, hs->mindamage = mindamage_def, hs->stamina = def_stamina;
 			
 			file >> level_solo >> level_timer >> level_squad;
 			file >> money;
@@ -589,36 +633,21 @@ namespace Environment::Character{
 				file >> backpack.list_throw[i].second.first;
 				file >> backpack.list_throw[i].second.second;
 				
-				for(int j = 0; j + 1 < backpack.list_throw[i].second.first; ++j)
-					backpack.list_throw[i].first.upgrade();
+				backpack.list_throw[i].first.set_upgrades(backpack.list_throw[i].second.first - 1);
 				backpack.set_vol(backpack.get_vol() + backpack.list_throw[i].second.second * backpack.list_throw[i].first.get_vol());
 			}
 
 			for(int i = 0; i < 8; ++i){
 				file >> backpack.list_w[i].second;
-				for(int j = 0; j < backpack.list_w[i].second; ++j)
-					backpack.list_w[i].first.upgrade();
+				backpack.list_w[i].first.set_upgrades(backpack.list_w[i].second);
 				backpack.set_vol(backpack.get_vol() + backpack.list_w[i].second * backpack.list_w[i].first.get_vol());
 			}
-			int k, k1;
+			int k;
 			file >> k;
-			while(--k)
-				backpack.upgrade();
-			k1 = k = level_solo;
-			level_solo = 1;
-			while(--k)
-				level_solo_up();
-			level_solo = k1;
-			k1 = k = level_timer;
-			level_timer = 1;
-			while(--k)
-				level_timer_up();
-			level_timer = k1;
-			k1 = k = level_squad;
-			level_squad = 1;
-			while(--k)
-				level_squad_up();
-			level_squad = k1;
+			backpack.upgrade(k - 1);
+			levels_up(1, level_solo);
+			levels_up(1, level_timer);
+			levels_up(1, level_squad);
 			backpack.back_tmp();
 			return;
 		}
@@ -667,7 +696,7 @@ namespace Environment::Character{
 					name = _name;
 			}
 			f >> def_Hp >> mindamage_def >> def_stamina >> level_solo >> level_timer >> level_squad >> money >> rate_solo >> rate_timer >> rate_squad >> rate;
-			Hp = def_Hp, mindamage = mindamage_def, stamina = def_stamina;
+			hs->Hp = def_Hp, hs->mindamage = mindamage_def, hs->stamina = def_stamina;
 			for(int i = 0; i < 4; ++i){
 				f >> backpack.list_cons[i].second;
 				backpack.set_vol(backpack.get_vol() + backpack.list_cons[i].second * backpack.list_cons[i].first.get_vol());
@@ -675,35 +704,20 @@ namespace Environment::Character{
 			for(int i = 0; i < 4; ++i){
 				f >> backpack.list_throw[i].second.first;
 				f >> backpack.list_throw[i].second.second;
-				for(int j = 0; j + 1 < backpack.list_throw[i].second.first; ++j)
-					backpack.list_throw[i].first.upgrade();
+				backpack.list_throw[i].first.set_upgrades(backpack.list_throw[i].second.first - 1);
 				backpack.set_vol(backpack.get_vol() + backpack.list_throw[i].second.second * backpack.list_throw[i].first.get_vol());
 			}
 			for(int i = 0; i < 8; ++i){
 				f >> backpack.list_w[i].second;
-				for(int j = 0; j < backpack.list_w[i].second; ++j)
-                    backpack.list_w[i].first.upgrade();
+				backpack.list_w[i].first.set_upgrades(backpack.list_w[i].second);
 				backpack.set_vol(backpack.get_vol() + backpack.list_w[i].second * backpack.list_w[i].first.get_vol());
 			}
-			int k, k1;
+			int k;
 			f >> k;
-			while(--k)
-				backpack.upgrade();
-            k1 = k = level_solo;
-            level_solo = 1;
-			while(--k)
-				level_solo_up();
-            level_solo = k1;
-            k1 = k = level_timer;
-            level_timer = 1;
-			while(--k)
-				level_timer_up();
-            level_timer = k1;
-            k1 = k = level_squad;
-            level_squad = 1;
-			while(--k)
-				level_squad_up();
-            level_squad = k1;
+			backpack.upgrade(k - 1);
+			levels_up(1, level_solo);
+			levels_up(1, level_timer);
+			levels_up(1, level_squad);
 			backpack.back_tmp();
 			return;
 		}
@@ -729,32 +743,43 @@ namespace Environment::Character{
 		}
 
 		void back_stamina(){
-			stamina = def_stamina;
+			hs->stamina = def_stamina;
 			return;
 		}
 
 		void set_stamina(int stamina){
-			this->stamina = stamina;
+			hs->stamina = stamina;
 			return;
 		}
 
 		int get_stamina() const{
-			return stamina;
+			return hs->stamina;
 		}
 
 		void turn_r(){
-			if(way == 1)
-				way = 4;
+			if(hs->way == 1)
+				hs->way = 4;
 			else
-				--way;
+				--hs->way;
 			return;
 		}
 
 		void turn_l(){
-			if(way == 4)
-				way = 1;
+			if(hs->way == 4)
+				hs->way = 1;
 			else
-				++way;
+				++hs->way;
+			return;
+		}
+
+		// same as calling level_*_up() once for every level in (from, to]
+		void levels_up(int from, int to){
+			if(to <= from)
+				return;
+			mindamage_def += 5 * (to - from);
+			def_Hp += 50 * (to - from);
+			def_stamina += 50 * (to - from);
+			backpack.increase_def((to + 1) / 2 - (from + 1) / 2);
 			return;
 		}
 
@@ -801,30 +826,30 @@ namespace Environment::Character{
 		}
 
 		void set_way(int way){
-			this->way = way;
+			hs->way = way;
 			return;
 		}
 
 		int get_way() const{
-			return way;
+			return hs->way;
 		}
 
 		void back_Hp(){
-			Hp = def_Hp;
+			hs->Hp = def_Hp;
 			return;
 		}
 
 		void back_mindamage(){
-			mindamage = mindamage_def;
+			hs->mindamage = mindamage_def;
 			return;
 		}
 
 		virtual std::string subtitle() override{
 		    std::vector<int> v = get_damage_effect();
-			return "username: " + name + ", Hp: " + std::to_string(Hp) + "\n" +
-			"stamina: " + std::to_string(stamina) + ", money: " + std::to_string(money) + "\n" +
-			"selected item: " + backpack.get_select() + ", mindamage: " + std::to_string(mindamage) +"\n" +
-			"coordinate: " + std::to_string(cor[0]) + ", " + std::to_string(cor[1]) + ", " + std::to_string(cor[2]) +
+			return "username: " + name + ", Hp: " + std::to_string(hs->Hp) + "\n" +
+			"stamina: " + std::to_string(hs->stamina) + ", money: " + std::to_string(money) + "\n" +
+			"selected item: " + backpack.get_select() + ", mindamage: " + std::to_string(hs->mindamage) +"\n" +
+			"coordinate: " + std::to_string(hs->cor[0]) + ", " + std::to_string(hs->cor[1]) + ", " + std::to_string(hs->cor[2]) +
 			", damage: " + std::to_string(v[0]) + ", effect: " + std::to_string(v[1]) + "\n";
 		}
 	};
@@ -837,8 +862,8 @@ namespace Environment::Character{
 	public:
 		bool punch(Environment::Item::Bullet &b, int way){
 			Environment::Item::Weapon p;
-			p.ready(std::max(0, mindamage), 0, 1);
-			std::vector<int> cor_ = {cor[0], cor[1] + wdx[way], cor[2] + wdy[way]};
+			p.ready(std::max(0, hs->mindamage), 0, 1);
+			std::vector<int> cor_ = {hs->cor[0], hs->cor[1] + wdx[way], hs->cor[2] + wdy[way]};
 			b.shot(cor_, way + 1, p, 0);
 			return true;
 		}
@@ -852,14 +877,14 @@ namespace Environment::Character{
 			name = (b ? "S" : "");
 			name += "Z" + std::to_string(time(0));
 			mindamage_def = (b + 1) * 100, def_Hp = (b + 1) * 400;
-			mindamage = mindamage_def, Hp = def_Hp;
+			hs->mindamage = mindamage_def, hs->Hp = def_Hp;
 			return;
 		}
 
 		virtual std::string subtitle() override{
-			return (std::string)(super ? "super " : "") + "zombie: " + name + ", Hp = " + std::to_string(Hp) + "\n" +
-			"cordinate: " + std::to_string(cor[0]) + ", " + std::to_string(cor[1]) + ", " + std::to_string(cor[2]) +
-			", damage: " + std::to_string(std::max(0, mindamage)) + "\n\n";
+			return (std::string)(super ? "super " : "") + "zombie: " + name + ", Hp = " + std::to_string(hs->Hp) + "\n" +
+			"cordinate: " + std::to_string(hs->cor[0]) + ", " + std::to_string(hs->cor[1]) + ", " + std::to_string(hs->cor[2]) +
+			", damage: " + std::to_string(std::max(0, hs->mindamage)) + "\n\n";
 		}
 	};
 
@@ -26,6 +26,24 @@ SOFTWARE.
 
 namespace Environment::Item{
 
+	int compute_damage(int x, int y){
+    	int l = 0, r = x + 1, z = 2;
+    	while(1 < y){
+	        y >>= 1;
+    	    ++z;
+    	}
+	    while(r - l > 1){
+    	    int mid = (l + r) >> 1, tmp = x;
+        	for(int i = 0; i < z && mid; ++i)
+            	tmp /= mid;
+	        	if(tmp)
+    	        	l = mid;
+        		else
+            		r = mid;
+    	}
+    	return l;
+	}
+
 	class Item{
 
 	protected:
@@ -170,12 +188,138 @@ namespace Environment::Item{
 		std::vector<int> get_dcor(){
 			return dcor;
 		}
+
+		// cells traveled on its floor since it was shot
+		int traveled() const{
+			return abs(cor[1] - dcor[1]) + abs(cor[2] - dcor[2]);
+		}
 	};
 
 	ConsumableItem cons[4];
 	Weapon w[8];
 	Bullet throw_[4];
 
+	// stats of every item after 0, 1, 2, ... upgrades, shared by all backpacks. power is
+	// compute_damage(damage, range) of a weapon at that level, the lower bound of its hits.
+	// levels are only added by reserve() when an item_ref is upgraded, so at() is a plain read
+	// and observation threads may call it
+	template<typename T>
+	class catalog{
+		static inline std::vector<std::deque<T>> table;
+		static inline std::vector<std::deque<int>> power;
+
+		static void extend(int id){
+			T x = table[id].back();
+			if constexpr(std::is_base_of_v<Weapon, T>)
+				x.upgrade();
+			table[id].push_back(x);
+			if constexpr(std::is_base_of_v<Weapon, T>)
+				power[id].push_back(compute_damage(x.get_damage(), x.get_range()));
+			else
+				power[id].push_back(0);
+			return;
+		}
+
+	public:
+		static void build(const T* base, int n, int levels){
+			table.assign(n, {});
+			power.assign(n, {});
+			for(int i = 0; i < n; ++i){
+				table[i].push_back(base[i]);
+				if constexpr(std::is_base_of_v<Weapon, T>)
+					power[i].push_back(compute_damage(base[i].get_damage(), base[i].get_range()));
+				else
+					power[i].push_back(0);
+				while((int)table[i].size() < levels)
+					extend(i);
+			}
+			return;
+		}
+
+		static void reserve(int id, int up){
+			while((int)table[id].size() <= up)
+				extend(id);
+			return;
+		}
+
+		static const T& at(int id, int up){
+			return table[id][up];
+		}
+
+		static int power_at(int id, int up){
+			return power[id][up];
+		}
+	};
+
+	// what a backpack stores of an item: which one and how many times it was upgraded
+	template<typename T>
+	class item_ref{
+		int id = 0, up = 0;
+
+	public:
+		item_ref(int id = 0): id(id){}
+
+		const T& get() const{
+			return catalog<T>::at(id, up);
+		}
+
+		operator const T&() const{
+			return get();
+		}
+
+		std::string get_name() const{
+			return get().get_name();
+		}
+
+		int get_stamina() const{
+			return get().get_stamina();
+		}
+
+		int get_price() const{
+			return get().get_price();
+		}
+
+		int get_vol() const{
+			return get().get_vol();
+		}
+
+		int get_level() const{
+			return get().get_level();
+		}
+
+		int get_Hp() const{
+			return get().get_Hp();
+		}
+
+		int get_damage() const{
+			return get().get_damage();
+		}
+
+		int get_effect() const{
+			return get().get_effect();
+		}
+
+		int get_range() const{
+			return get().get_range();
+		}
+
+		int get_power() const{
+			return catalog<T>::power_at(id, up);
+		}
+
+		void upgrade(){
+			++up;
+			catalog<T>::reserve(id, up);
+			return;
+		}
+
+		void set_upgrades(int up){
+			this->up = std::max(up, 0);
+			catalog<T>::reserve(id, this->up);
+			return;
+		}
+	};
+
 	void download_items(){
 		std::string s[8] = {"0", "1", "2", "3", "4", "5", "6", "7"};
 		for(int i = 0; i < 4; ++i)
@@ -184,6 +328,9 @@ namespace Environment::Item{
 			throw_[i].build_throw("./Items/throw" + s[i] + ".txt");
 		for(int i = 0; i < 8; ++i)
 			w[i].build_w("./Items/w" + s[i] + ".txt");
+		catalog<ConsumableItem>::build(cons, 4, 1);
+		catalog<Bullet>::build(throw_, 4, 16);
+		catalog<Weapon>::build(w, 8, 16);
 		return;
 	}
 
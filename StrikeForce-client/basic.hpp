@@ -27,16 +27,21 @@ SOFTWARE.
 
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <ctime>
 #include <cstring>
 #include <fstream>
 #include <algorithm>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <unistd.h>
 #include <bitset>
+#include <queue>
 #include <random>
 #include <filesystem>
+#include <memory>
+#include <type_traits>
 
 #include "GraphicPrinter.hpp"
 
@@ -26,6 +26,15 @@ SOFTWARE.
 // Add -lws2_32 on Windows
 
 #include "Modules.hpp"
+#include "../common/SparseObs.hpp"
+#include "../common/PolicyFile.hpp"
+#include <map>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#if defined(FUSED_POLICY)
+#include "../common/PolicyEngine.hpp"
+#endif
 
 #if defined(DISTRIBUTED_LEARNING)
 #include "AgentClient.hpp"
@@ -33,12 +42,47 @@ SOFTWARE.
 
 const std::string bot_code = "bot-0.5", backup_path = "bots/bot-0.5/backup";
 
-class Agent {
-public:
-    Agent(bool training = true, int T = 1024, int num_epochs = 4, float gamma = 0.99, float learning_rate = 1e-3,
-         float ppo_clip = 0.2, float cv = 0.5, const std::string &backup_dir = "bots/bot-0.5/backup/agent_backup")
-        : training(training), T(T), num_epochs(num_epochs), gamma(gamma), learning_rate(learning_rate),
-        ppo_clip(ppo_clip), cv(cv), backup_dir(backup_dir) {
+#if defined(INFERENCE_ONLY)
+#include "../common/PlayAgent.hpp"
+#else
+
+// what every agent playing from one backup_dir shares: the model, its optimizer and the log.
+// the first agent to ask for a backup_dir loads it and end_match() saves it, so an extra agent
+// only costs its own recurrent state and rollout
+struct PolicyPool {
+    bool training, logging = true;
+    std::string backup_dir;
+    AgentModel model{nullptr};
+
+#if !defined(DISTRIBUTED_LEARNING)
+    std::unique_ptr<torch::optim::AdamW> optimizer{nullptr};
+#else
+    std::unique_ptr<AgentClient> client{nullptr};
+#endif
+
+    std::ofstream log_file;
+    std::vector<torch::Tensor> coor[2], initial;
+    // decisions made, forwards run for them and the time they took, logged when the pool goes
+    long long decisions = 0, batches = 0;
+    double decide_us = 0;
+#if defined(FUSED_POLICY)
+    // the model packed for the fused forward, or null while it doesn't match the model
+    std::unique_ptr<policy_engine> engine;
+    // the thread repack() runs, the engine it made and what to log about it, handed over by adopt()
+    std::thread packer;
+    std::unique_ptr<policy_engine> packed;
+    std::vector<std::string> pack_notes;
+    std::atomic<bool> pack_ready{false};
+#endif
+#if defined(QUANTIZED_POLICY)
+    // the first observations one agent of the pool decided on, to calibrate int8 weights with
+    static const size_t calibration_size = 256;
+    std::vector<sparse_obs> calibration;
+    const void* recorder = nullptr;
+#endif
+
+    PolicyPool(bool training, float learning_rate, const std::string &backup_dir)
+        : training(training), backup_dir(backup_dir) {
 
 #if defined(DISTRIBUTED_LEARNING)
         std::cout << "=== DISTRIBUTED LEARNING MODE ===" << std::endl;
@@ -129,18 +173,22 @@ public:
 #endif
         }
         
-        auto dummy = torch::zeros({1, num_channels, grid_x, grid_y});
+        auto dummy = torch::zeros({1, model->num_channels, model->grid_x, model->grid_y});
         model->forward(dummy);
         model->reset_memory();
+#if defined(FUSED_POLICY)
+        repack();
+#endif
     }
     
-    ~Agent() {
-        if (is_training && trainThread.joinable()) {
-            std::cout << "Agent Network is updating...\n";
-            trainThread.join();
-            std::cout << "done!" << std::endl;
-        }
-        
+    ~PolicyPool() {
+#if defined(FUSED_POLICY)
+        if (packer.joinable())
+            packer.join();
+#endif
+        if (batches)
+            log("A decisions=" + std::to_string(decisions) + ",batches=" + std::to_string(batches) +
+                ",us/batch=" + std::to_string(decide_us / batches) + ",us/decision=" + std::to_string(decide_us / decisions));
         if (training) {
             coor[0].clear();
             for (auto &p: initial)
@@ -154,14 +202,6 @@ public:
         log_file.close();
         
 #if !defined(DISTRIBUTED_LEARNING)
-        if (training && !backup_dir.empty() && std::filesystem::exists(backup_dir)) {
-            model->reset_memory();
-            torch::save(model, backup_dir + "/model.pt");
-            if (optimizer) {
-                torch::save(*optimizer, backup_dir + "/optimizer.pt");
-            }
-        }
-
     #if defined(CROWDSOURCED_TRAINING)
         std::cout << "Submit backup to server? (y/n)" << std::endl;
         if (getch() == 'y') {
@@ -175,43 +215,303 @@ public:
 #endif
     }
 
-    int predict(const std::vector<float>& obs) {
-        if (cnt <= T_initial)
-            return 0;
-            
-        if (is_training) {
-#if !defined(CROWDSOURCED_TRAINING) && !defined(DISTRIBUTED_LEARNING)
-            if (done_training) {
-                is_training = false;
-                if (trainThread.joinable())
-                    trainThread.join();
-            } else {
-                return 0;
+    // the pools in use by backup_dir and training settings. a pool stays here while no agent holds
+    // it, so agents dying and spawning during a match don't load and save it again
+    static std::map<std::tuple<std::string, bool, float>, std::shared_ptr<PolicyPool>>& pools() {
+        static std::map<std::tuple<std::string, bool, float>, std::shared_ptr<PolicyPool>> res;
+        return res;
+    }
+
+    // the pool of backup_dir for agents with these training settings, loaded by the first agent
+    // that asks for it. agents that train differently get pools of their own
+    static std::shared_ptr<PolicyPool> get(bool training, float learning_rate, const std::string &backup_dir) {
+        auto &pool = pools()[{backup_dir, training, learning_rate}];
+        if (!pool)
+            pool = std::make_shared<PolicyPool>(training, learning_rate, backup_dir);
+        return pool;
+    }
+
+    // saves every pool when a match ends. pools no agent holds any more go, the others serve the
+    // agents that outlive the match
+    static void end_match() {
+        auto &all = pools();
+        for (auto it = all.begin(); it != all.end();) {
+            it->second->save();
+            it = it->second.use_count() == 1 ? all.erase(it) : std::next(it);
+        }
+    }
+
+    // writes model.pt, policy.sfw and optimizer.pt to backup_dir if the pool trains
+    void save() {
+#if !defined(DISTRIBUTED_LEARNING)
+        if (training && !backup_dir.empty() && std::filesystem::exists(backup_dir)) {
+            model->reset_memory();
+            torch::save(model, backup_dir + "/model.pt");
+            export_policy();
+            if (optimizer) {
+                torch::save(*optimizer, backup_dir + "/optimizer.pt");
             }
-#else
-            return 0;
+        }
 #endif
+    }
+
+    // writes the model to backup_dir/policy.sfw, the flat weight file INFERENCE_ONLY builds play from
+    void export_policy() {
+        std::vector<torch::Tensor> keep;
+        std::vector<policy_tensor> tensors;
+        for (auto &p: model->named_parameters()) {
+            keep.push_back(p.value().detach().contiguous());
+            tensors.push_back({p.key(), keep.back().data_ptr<float>(), (size_t)keep.back().numel()});
         }
-        
-        auto state = torch::tensor(obs, torch::dtype(torch::kFloat32)).view({1, num_channels, grid_x, grid_y});
-        states.push_back(state);
-        auto output = model->forward(state);
-        values.push_back(output[1]);
-        log_probs.push_back(torch::log(output[0]));
-        
-        std::vector<float> v;
-        for (int i = 0; i < num_actions; ++i)
-            v.push_back(output[0][i].item<float>());
-            
-#if !defined(SLOWMOTION)
-        for (int i = 1; i < num_actions; ++i)
-            v[i] *= 0.5f / (1 - v[0] + 1e-5f);
-        v[0] = 0.5f;
+        if (!write_policy_file(backup_dir + "/policy.sfw", model->num_channels, model->grid_x, model->hidden_size, model->num_actions, tensors))
+            log("could not write " + backup_dir + "/policy.sfw");
+    }
+
+    std::vector<torch::Tensor> snap_shot() {
+        std::vector<torch::Tensor> params;
+        for (auto& p : model->parameters())
+            params.push_back(p.detach().clone());
+        return params;
+    }
+
+    double calc_diff() {
+        coor[1] = snap_shot();
+        double diff = 0;
+        for (size_t i = 0; i < coor[0].size(); ++i)
+            diff += (coor[1][i] - coor[0][i]).pow(2).sum().item<float>();
+        coor[0].clear();
+        for (auto& p: coor[1])
+            coor[0].push_back(p.detach().clone());
+        coor[1].clear();
+        return std::sqrt(diff);
+    }
+
+#if defined(FUSED_POLICY)
+    // packs the model into a new engine on a thread of its own, so the fold never stalls the game.
+    // the pool decides through libtorch until adopt() takes the engine over, and the model must not
+    // change before that (see finish_pack). a model that doesn't pack, or doesn't match (see
+    // matches), keeps deciding through libtorch
+    void repack() {
+        finish_pack();
+        engine.reset();
+        packer = std::thread([this] {
+            torch::InferenceMode guard;
+            auto e = std::make_unique<policy_engine>();
+            if (!e->load(model)) {
+                e.reset();
+                pack_notes.push_back("policy_engine: model layout not supported");
+            }
+            else if (!matches(*e))
+                e.reset();
+#if defined(QUANTIZED_POLICY)
+            // nothing is recorded while there's no engine, so calibration holds still here
+            else if (calibration.size() == calibration_size)
+                pack_notes.push_back(quantize(*e));
 #endif
-        
-        std::mt19937 gen(std::random_device{}());
-        std::discrete_distribution<> dist(v.begin(), v.end());
-        return dist(gen);
+            packed = std::move(e);
+            pack_ready = true;
+        });
+    }
+
+    // puts the engine repack() made in place once it's ready; cheap enough to call before every batch
+    void adopt() {
+        if (!pack_ready)
+            return;
+        if (packer.joinable())
+            packer.join();
+        pack_ready = false;
+        engine = std::move(packed);
+        for (auto &note: pack_notes)
+            log(note);
+        pack_notes.clear();
+    }
+
+    // waits for the engine repack() is making, before the model changes
+    void finish_pack() {
+        if (packer.joinable())
+            packer.join();
+        adopt();
+    }
+
+    // whether e decides as model->step does, within 1e-5, on a few random observations. that
+    // depends on the code rather than the weights, so only the first engine of the process is checked
+    bool matches(policy_engine& e) {
+        static std::once_flag checked;
+        static bool ok = false;
+        std::call_once(checked, [&] {
+            int A = model->num_actions;
+            auto h0 = torch::zeros({1, 1, model->hidden_size}), h1 = torch::zeros({1, 1, model->hidden_size});
+            auto e0 = h0.clone(), e1 = h1.clone(), a = torch::zeros({1, A});
+            auto p = torch::empty({A}), v = torch::empty({1});
+            float err = 0;
+            for (int t = 0; t < 4; ++t) {
+                auto x = torch::rand({1, model->num_channels, model->grid_x, model->grid_y});
+                a.zero_();
+                a[0][t % A] += 1;
+                auto out = model->step(x, h0, h1, a);
+                e.step(x.data_ptr<float>(), e0.data_ptr<float>(), e1.data_ptr<float>(), a.data_ptr<float>(), p.data_ptr<float>(), v.data_ptr<float>());
+                h0 = out[2], h1 = out[3];
+                err = std::max({err, (out[0].view({-1}) - p).abs().max().item<float>(), (out[1] - v).abs().max().item<float>()});
+            }
+            pack_notes.push_back("policy_engine: max error=" + std::to_string(err));
+            ok = err <= 1e-5f;
+        });
+        return ok;
+    }
+#endif
+
+#if defined(QUANTIZED_POLICY)
+    // int8 weights for e, calibrated on the recorded observations. says how they compare with fp32
+    // on those observations, and e stays fp32 if they pick another action too often
+    std::string quantize(policy_engine& e) const {
+        std::vector<std::vector<float>> dense;
+        std::vector<const float*> obs;
+        for (auto &s: calibration) {
+            dense.emplace_back((size_t)model->num_channels * model->grid_x * model->grid_y);
+            s.densify(dense.back().data(), dense.back().size());
+        }
+        for (auto &d: dense)
+            obs.push_back(d.data());
+        quant_report r;
+        bool kept = e.quantize(obs, 0.95, r);
+        return "policy_engine int8: agreement=" + std::to_string(r.agreement) + ",kl=" + std::to_string(r.kl) +
+            ",value_err=" + std::to_string(r.value_err) + ",KB=" + std::to_string(r.fp32_bytes / 1024) + "->" +
+            std::to_string(r.int8_bytes / 1024) + (kept ? "" : ",kept fp32");
+    }
+#endif
+
+    template<typename Type>
+    void log(const Type& message) {
+        if (!logging) return;
+        log_file << message << std::endl;
+        log_file.flush();
+    }
+};
+
+class Agent {
+public:
+    Agent(bool training = true, int T = 1024, int num_epochs = 4, float gamma = 0.99, float learning_rate = 1e-3,
+         float ppo_clip = 0.2, float cv = 0.5, const std::string &backup_dir = "bots/bot-0.5/backup/agent_backup")
+        : pool(PolicyPool::get(training, learning_rate, backup_dir)), T(T), num_epochs(num_epochs), gamma(gamma),
+        learning_rate(learning_rate), ppo_clip(ppo_clip), cv(cv), backup_dir(backup_dir) {
+        this->training = pool->training;
+        model = pool->model;
+        reset_memory();
+    }
+    
+    ~Agent() {
+        if (is_training && trainThread.joinable()) {
+            std::cout << "Agent Network is updating...\n";
+            trainThread.join();
+            std::cout << "done!" << std::endl;
+        }
+    }
+
+    // saves what the agents of the match learned; the game calls it when a match ends
+    static void end_match() {
+        PolicyPool::end_match();
+    }
+
+    // an observation tensor for Custom to encode into; predict keeps a sparse copy for training
+    torch::Tensor new_state() {
+        return new_states(1);
+    }
+
+    // k observations in one tensor, for encode_batch and a single forward call. the tensor is
+    // this agent's input buffer, reused by the next call
+    torch::Tensor new_states(int k) {
+        if (!input.defined() || input.size(0) < k)
+            input = torch::empty({k, num_channels, grid_x, grid_y}, torch::dtype(torch::kFloat32));
+        return input.narrow(0, 0, k);
+    }
+
+    // a rollout state back as the tensor predict got, in its own memory for autograd
+    torch::Tensor dense(const sparse_obs& s) const {
+        auto state = torch::empty({1, num_channels, grid_x, grid_y}, torch::dtype(torch::kFloat32));
+        s.densify(state.data_ptr<float>(), state.numel());
+        return state;
+    }
+
+    int predict(const std::vector<float>& obs) {
+        return predict(torch::tensor(obs, torch::dtype(torch::kFloat32)).view({1, num_channels, grid_x, grid_y}));
+    }
+
+    int predict(const torch::Tensor& state) {
+        return predict_batch({this}, state)[0];
+    }
+
+    // a decision for each of agents, where row i of states is what agents[i] sees. agents sharing a
+    // model go through it in one forward, each with its own recurrent state as a row of the batch
+    static std::vector<int> predict_batch(const std::vector<Agent*>& agents, const torch::Tensor& states) {
+        std::vector<int> res(agents.size(), 0), rows;
+        for (int i = 0; i < (int)agents.size(); ++i)
+            if (agents[i]->acting())
+                rows.push_back(i);
+
+        // decisions keep no autograd state; train() replays the rollout through forward for that
+        torch::InferenceMode guard;
+        while (!rows.empty()) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<int> group, rest;
+            for (int i: rows)
+                (agents[i]->model.get() == agents[rows[0]]->model.get() ? group : rest).push_back(i);
+            rows.swap(rest);
+
+            auto &pool = *agents[group[0]]->pool;
+            int k = group.size(), A = agents[group[0]]->num_actions;
+            std::vector<int64_t> index(group.begin(), group.end());
+            auto x = (k == states.size(0) ? states : states.index_select(0, torch::tensor(index))).contiguous();
+            torch::Tensor p, v;
+#if defined(FUSED_POLICY)
+            pool.adopt();
+            if (pool.engine) {
+                // one fused step over the k rows, with each row's GRU states updated in place
+                p = torch::empty({k, A}), v = torch::empty({k});
+                std::vector<float*> h0, h1;
+                std::vector<const float*> a;
+                for (int i: group) {
+                    h0.push_back(agents[i]->h_state[0].data_ptr<float>());
+                    h1.push_back(agents[i]->h_state[1].data_ptr<float>());
+                    a.push_back(agents[i]->action_input.data_ptr<float>());
+                }
+                pool.engine->step_batch(k, x.data_ptr<float>(), x[0].numel(), h0.data(), h1.data(), a.data(), p.data_ptr<float>(), v.data_ptr<float>());
+            }
+            else
+#endif
+            {
+                std::vector<torch::Tensor> h0, h1, a;
+                for (int i: group) {
+                    h0.push_back(agents[i]->h_state[0]);
+                    h1.push_back(agents[i]->h_state[1]);
+                    a.push_back(agents[i]->action_input);
+                }
+                auto output = agents[group[0]]->model->step(x, torch::cat(h0, 1), torch::cat(h1, 1), torch::stack(a));
+                p = output[0].contiguous(), v = output[1];
+                for (int r = 0; r < k; ++r) {
+                    agents[group[r]]->h_state[0] = output[2].narrow(1, r, 1);
+                    agents[group[r]]->h_state[1] = output[3].narrow(1, r, 1);
+                }
+            }
+
+            for (int r = 0; r < k; ++r) {
+                Agent& agent = *agents[group[r]];
+                agent.states.emplace_back(x[r].data_ptr<float>(), x[r].numel());
+#if defined(QUANTIZED_POLICY)
+                if (pool.engine && pool.calibration.size() < PolicyPool::calibration_size && (!pool.recorder || pool.recorder == &agent)) {
+                    pool.recorder = &agent;
+                    pool.calibration.push_back(agent.states.back());
+                    if (pool.calibration.size() == PolicyPool::calibration_size)
+                        pool.log(pool.quantize(*pool.engine));
+                }
+#endif
+                res[group[r]] = agent.sample(p.data_ptr<float>() + r * A);
+            }
+
+            pool.decisions += group.size();
+            ++pool.batches;
+            pool.decide_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        }
+        return res;
     }
 
     void update(int action, bool imitate) {
@@ -220,7 +520,7 @@ public:
             
         auto one_hot = torch::zeros({num_actions});
         one_hot[action] += 1;
-        model->update_actions(one_hot);
+        action_input = one_hot;
         actions.push_back(action);
         
         if (actions.size() == T) {
@@ -268,59 +568,86 @@ public:
     }
 
 private:
-    bool is_training = false, logging = true, training, done_training = false, manual = false;
+    std::shared_ptr<PolicyPool> pool;
+    bool is_training = false, training, done_training = false, manual = false;
     std::thread trainThread;
     float learning_rate, gamma, ppo_clip, cv;
     int T, num_epochs, cnt = 0, T_initial = 10;
-    const int num_actions = 9, num_channels = 32, grid_x = 31, grid_y = 31, hidden_size = 160;
+    const int num_actions = 9, num_channels = bot_schema::channels, grid_x = bot_schema::side, grid_y = bot_schema::side, hidden_size = 160;
     std::string backup_dir;
+    // the pool's model, the same module under another handle
     AgentModel model{nullptr};
     
-#if !defined(DISTRIBUTED_LEARNING)
-    std::unique_ptr<torch::optim::AdamW> optimizer{nullptr};
-#else
-    std::unique_ptr<AgentClient> client{nullptr};
-#endif
-    
-    std::vector<torch::Tensor> states, log_probs, values, rewards;
+    std::vector<torch::Tensor> rewards;
+    std::vector<sparse_obs> states;
     std::vector<int> actions;
-    std::ofstream log_file;
-    std::vector<torch::Tensor> coor[2], initial;
+    torch::Tensor input;
 
-    std::vector<torch::Tensor> snap_shot() {
-        std::vector<torch::Tensor> params;
-        for (auto& p : model->parameters())
-            params.push_back(p.detach().clone());
-        return params;
+    // this agent's recurrent state in its rollout, what the model's step gets for its row
+    torch::Tensor h_state[2], action_input;
+
+    void reset_memory() {
+        action_input = torch::zeros({num_actions});
+        action_input[0] += 1;
+        h_state[0] = torch::zeros({1, 1, hidden_size});
+        h_state[1] = torch::zeros({1, 1, hidden_size});
     }
 
-    double calc_diff() {
-        coor[1] = snap_shot();
-        double diff = 0;
-        for (size_t i = 0; i < coor[0].size(); ++i)
-            diff += (coor[1][i] - coor[0][i]).pow(2).sum().item<float>();
-        coor[0].clear();
-        for (auto& p: coor[1])
-            coor[0].push_back(p.detach().clone());
-        coor[1].clear();
-        return std::sqrt(diff);
+    // whether the model decides for this agent now; while it warms up or trains it answers 0
+    bool acting() {
+        if (cnt <= T_initial)
+            return false;
+            
+        if (is_training) {
+#if !defined(CROWDSOURCED_TRAINING) && !defined(DISTRIBUTED_LEARNING)
+            if (done_training) {
+                is_training = false;
+                if (trainThread.joinable())
+                    trainThread.join();
+            } else {
+                return false;
+            }
+#else
+            return false;
+#endif
+        }
+        return true;
     }
 
-    template<typename Type>
-    void log(const Type& message) {
-        if (!logging) return;
-        log_file << message << std::endl;
-        log_file.flush();
+    // seeded once per agent, not once per decision
+    std::mt19937 gen{std::random_device{}()};
+
+    // draws an action from the policy's probabilities p
+    int sample(const float* p) {
+        std::vector<float> v(p, p + num_actions);
+            
+#if !defined(SLOWMOTION)
+        for (int i = 1; i < num_actions; ++i)
+            v[i] *= 0.5f / (1 - v[0] + 1e-5f);
+        v[0] = 0.5f;
+#endif
+        
+        std::discrete_distribution<> dist(v.begin(), v.end());
+        return dist(gen);
     }
 
     void train() {
+#if defined(FUSED_POLICY)
+        pool->finish_pack();
+#endif
         time_t ts = time(0);
         auto loss = torch::zeros({1});
         auto H = torch::zeros({1});
         
+        // predict kept no graph, so the rollout is replayed through the model from a fresh memory
+        model->reset_memory();
         for (size_t i = 0; i < T; ++i) {
-            loss -= log_probs[i][actions[i]];
-            H -= (log_probs[i] * torch::exp(log_probs[i])).sum();
+            auto log_p = torch::log(model->forward(dense(states[i]))[0]);
+            auto one_hot = torch::zeros({num_actions});
+            one_hot[actions[i]] += 1;
+            model->update_actions(one_hot);
+            loss -= log_p[actions[i]];
+            H -= (log_p * torch::exp(log_p)).sum();
         }
         loss = loss / T;
         H = H / T;
@@ -341,10 +668,10 @@ private:
             }
             
             std::cout << "Sending gradients to server..." << std::endl;
-            client->send_gradient(gradients);
+            pool->client->send_gradient(gradients);
             
             std::cout << "Requesting update vector..." << std::endl;
-            auto update_vector = client->get_update_vector();
+            auto update_vector = pool->client->get_update_vector();
             
             std::cout << "Applying server update..." << std::endl;
             auto params = model->parameters();
@@ -355,23 +682,27 @@ private:
             std::cout << "Model synchronized with server" << std::endl;
 #else
             // Local mode: standard gradient descent
-            optimizer->zero_grad();
+            pool->optimizer->zero_grad();
             loss.backward();
-            optimizer->step();
+            pool->optimizer->step();
 #endif
         }
         
-        log("A: loss=" + std::to_string(loss.item<float>()) +
+        pool->log("A: loss=" + std::to_string(loss.item<float>()) +
             ",H=" + std::to_string(H.item<float>()) + 
             ",time(s)=" + std::to_string(time(0) - ts) +
-            ",step=" + std::to_string(calc_diff()));
+            ",step=" + std::to_string(pool->calc_diff()));
         
         actions.clear();
         rewards.clear();
-        log_probs.clear();
         states.clear();
-        values.clear();
         model->reset_memory();
+        reset_memory();
+#if defined(FUSED_POLICY)
+        if (training)
+            pool->repack();
+#endif
         done_training = true;
     }
-};
\ No newline at end of file
+};
+#endif
\ No newline at end of file
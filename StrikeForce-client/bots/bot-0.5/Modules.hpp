@@ -23,10 +23,13 @@ SOFTWARE.
 
 */
 #include "../../basic.hpp"
-#include <torch/torch.h>
+#include "../common/BotSchema.hpp"
 
 #define LAYER_INDEX 3
 
+#if !defined(INFERENCE_ONLY)
+#include <torch/torch.h>
+
 struct ResBImpl : torch::nn::Module {
     std::vector<torch::nn::Linear> layers;
     int num_layers;
@@ -38,12 +41,13 @@ struct ResBImpl : torch::nn::Module {
             );
     }
 
+    // X is one vector or a batch of rows; each row is rescaled on its own
     torch::Tensor forward(torch::Tensor X) {
         auto y = X.clone();
-        auto x = y * y.numel() / (y.abs().sum().detach() + 1e-8);
+        auto x = y * y.size(-1) / (y.abs().sum(-1, true).detach() + 1e-8);
         for (int i = 0; i < num_layers; ++i) {
             y = torch::relu(layers[i]->forward(x)) + x;
-            x = y * y.numel() / (y.abs().sum().detach() + 1e-8);
+            x = y * y.size(-1) / (y.abs().sum(-1, true).detach() + 1e-8);
         }
         return x;
     }
@@ -80,10 +84,10 @@ struct BackboneImpl : torch::nn::Module {
     int num_channels, grid_x, grid_y, hidden_size, num_actions;
     torch::Tensor action_input, h_state[2];
 
-    BackboneImpl(int num_channels = 32, int grid_x = 31, int grid_y = 31, int hidden_size = 160, int num_actions = 9)
+    BackboneImpl(int num_channels = bot_schema::channels, int grid_x = bot_schema::side, int grid_y = bot_schema::side, int hidden_size = 160, int num_actions = 9)
         : num_channels(num_channels), grid_x(grid_x), grid_y(grid_y),
           hidden_size(hidden_size), num_actions(num_actions) {
-        cnn = register_module("cnn", GameCNN(num_channels, hidden_size, 4, grid_x));
+        cnn = register_module("cnn", GameCNN(num_channels, hidden_size, cnn_layers(grid_x), grid_x));
         gru0 = register_module("gru0", torch::nn::GRU(torch::nn::GRUOptions(hidden_size, hidden_size).num_layers(1)));
         combined_processor = register_module("combined_processor", torch::nn::Sequential(
             torch::nn::Linear(2 * hidden_size + num_actions, hidden_size)
@@ -132,6 +136,35 @@ struct BackboneImpl : torch::nn::Module {
 
         return out;
     }
+
+    // forward for k agents at once, each with its own memory: x is [k, C, X, Y], h0 and h1 are
+    // [1, k, hidden_size] and a is [k, num_actions]. every rescale is per row, so row i is what
+    // forward gives agent i alone. returns {out, h0, h1} and leaves h_state and action_input alone
+    std::vector<torch::Tensor> step(const torch::Tensor &x, const torch::Tensor &h0, const torch::Tensor &h1, const torch::Tensor &a) {
+        int k = x.size(0);
+        auto feat = cnn->forward(x).view({k, -1});
+        feat = feat * hidden_size / (feat.abs().sum(1, true).detach() + 1e-8);
+
+        auto r0 = gru0->forward(feat.view({1, k, -1}), h0);
+        auto out_seq = std::get<0>(r0).view({k, -1});
+        out_seq = out_seq * hidden_size / (out_seq.abs().sum(1, true).detach() + 1e-8);
+
+        std::vector<torch::Tensor> y;
+        std::vector<std::vector<int>> d = {{-1, 0}, {0, -1}, {0, 0}, {0, 1}, {1, 0}};
+        for (auto e: d)
+            y.push_back(x.select(2, grid_x / 2 + e[0]).select(2, grid_y / 2 + e[1]));
+        auto pov = torch::cat({torch::cat(y, 1), a}, 1);
+        auto combined = torch::cat({out_seq + feat, pov * hidden_size / (pov.abs().sum(1, true).detach() + 1e-8)}, 1);
+
+        auto gated = combined_processor->forward(combined);
+        gated = gated * hidden_size / (gated.abs().sum(1, true).detach() + 1e-8);
+
+        auto r1 = gru1->forward(gated.view({1, k, -1}), h1);
+        auto out = std::get<0>(r1).view({k, -1});
+        out = out * hidden_size / (out.abs().sum(1, true).detach() + 1e-8) + gated;
+
+        return {out, std::get<1>(r0), std::get<1>(r1)};
+    }
 };
 TORCH_MODULE(Backbone);
 
@@ -141,7 +174,7 @@ struct AgentModelImpl : torch::nn::Module {
 
     int num_channels, grid_x, grid_y, hidden_size, num_actions;
 
-    AgentModelImpl(int num_channels = 32, int grid_x = 31, int grid_y = 31, int hidden_size = 160, int num_actions = 9)
+    AgentModelImpl(int num_channels = bot_schema::channels, int grid_x = bot_schema::side, int grid_y = bot_schema::side, int hidden_size = 160, int num_actions = 9)
         : num_channels(num_channels), grid_x(grid_x), grid_y(grid_y), hidden_size(hidden_size), num_actions(num_actions) {
         backbone = register_module("backbone", Backbone(num_channels, grid_x, grid_y, hidden_size, num_actions));
         value_head = register_module("value", torch::nn::Sequential(
@@ -176,5 +209,16 @@ struct AgentModelImpl : torch::nn::Module {
 
         return {p, v};
     }
+
+    // forward for a batch of agents, see BackboneImpl::step. returns {p, v, h0, h1} with p of [k, num_actions]
+    std::vector<torch::Tensor> step(const torch::Tensor &x, const torch::Tensor &h0, const torch::Tensor &h1, const torch::Tensor &a) {
+        auto r = backbone->step(x, h0, h1, a);
+
+        auto p = torch::softmax(policy_head->forward(r[0]), -1) + 1e-8;
+        auto v = torch::sigmoid(value_head->forward(r[0])).view({-1});
+
+        return {p, v, r[1], r[2]};
+    }
 };
-TORCH_MODULE(AgentModel);
\ No newline at end of file
+TORCH_MODULE(AgentModel);
+#endif
\ No newline at end of file
@@ -34,4 +34,6 @@ public:
     bool in_training(){return false;}
 
     bool is_manual(){return false;}
+
+    static void end_match(){return;}
 };
\ No newline at end of file
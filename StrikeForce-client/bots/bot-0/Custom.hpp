@@ -39,4 +39,8 @@ namespace Environment::Field{
     char gameplay::bot(Environment::Character::Human& player) const {
 		return '+';
     }
+
+    std::string gameplay::bots(const std::vector<int> &idx) const {
+		return std::string(idx.size(), '+');
+    }
 }
\ No newline at end of file
@@ -23,10 +23,13 @@ SOFTWARE.
 
 */
 #include "../../basic.hpp"
-#include <torch/torch.h>
+#include "../common/BotSchema.hpp"
 
 #define LAYER_INDEX 3
 
+#if !defined(INFERENCE_ONLY)
+#include <torch/torch.h>
+
 struct ResBImpl : torch::nn::Module {
     std::vector<torch::nn::Linear> layers;
     int num_layers;
@@ -38,12 +41,13 @@ struct ResBImpl : torch::nn::Module {
             );
     }
 
+    // X is one vector or a batch of rows; each row is rescaled on its own
     torch::Tensor forward(torch::Tensor X) {
         auto y = X.clone();
-        auto x = y * y.numel() / (y.abs().sum().detach() + 1e-8);
+        auto x = y * y.size(-1) / (y.abs().sum(-1, true).detach() + 1e-8);
         for (int i = 0; i < num_layers; ++i) {
             y = torch::relu(layers[i]->forward(x)) + x;
-            x = y * y.numel() / (y.abs().sum().detach() + 1e-8);
+            x = y * y.size(-1) / (y.abs().sum(-1, true).detach() + 1e-8);
         }
         return x;
     }
@@ -80,10 +84,10 @@ struct BackboneImpl : torch::nn::Module {
     int num_channels, grid_x, grid_y, hidden_size, num_actions;
     torch::Tensor action_input, h_state[2];
 
-    BackboneImpl(int num_channels = 32, int grid_x = 31, int grid_y = 31, int hidden_size = 160, int num_actions = 9)
+    BackboneImpl(int num_channels = bot_schema::channels, int grid_x = bot_schema::side, int grid_y = bot_schema::side, int hidden_size = 160, int num_actions = 9)
         : num_channels(num_channels), grid_x(grid_x), grid_y(grid_y),
           hidden_size(hidden_size), num_actions(num_actions) {
-        cnn = register_module("cnn", GameCNN(num_channels, hidden_size, 4, grid_x));
+        cnn = register_module("cnn", GameCNN(num_channels, hidden_size, cnn_layers(grid_x), grid_x));
         gru0 = register_module("gru0", torch::nn::GRU(torch::nn::GRUOptions(hidden_size, hidden_size).num_layers(1)));
         combined_processor = register_module("combined_processor", torch::nn::Sequential(
             torch::nn::Linear(2 * hidden_size + num_actions, hidden_size)
@@ -132,6 +136,35 @@ struct BackboneImpl : torch::nn::Module {
 
         return out;
     }
+
+    // forward for k agents at once, each with its own memory: x is [k, C, X, Y], h0 and h1 are
+    // [1, k, hidden_size] and a is [k, num_actions]. every rescale is per row, so row i is what
+    // forward gives agent i alone. returns {out, h0, h1} and leaves h_state and action_input alone
+    std::vector<torch::Tensor> step(const torch::Tensor &x, const torch::Tensor &h0, const torch::Tensor &h1, const torch::Tensor &a) {
+        int k = x.size(0);
+        auto feat = cnn->forward(x).view({k, -1});
+        feat = feat * hidden_size / (feat.abs().sum(1, true).detach() + 1e-8);
+
+        auto r0 = gru0->forward(feat.view({1, k, -1}), h0);
+        auto out_seq = std::get<0>(r0).view({k, -1});
+        out_seq = out_seq * hidden_size / (out_seq.abs().sum(1, true).detach() + 1e-8);
+
+        std::vector<torch::Tensor> y;
+        std::vector<std::vector<int>> d = {{-1, 0}, {0, -1}, {0, 0}, {0, 1}, {1, 0}};
+        for (auto e: d)
+            y.push_back(x.select(2, grid_x / 2 + e[0]).select(2, grid_y / 2 + e[1]));
+        auto pov = torch::cat({torch::cat(y, 1), a}, 1);
+        auto combined = torch::cat({out_seq + feat, pov * hidden_size / (pov.abs().sum(1, true).detach() + 1e-8)}, 1);
+
+        auto gated = combined_processor->forward(combined);
+        gated = gated * hidden_size / (gated.abs().sum(1, true).detach() + 1e-8);
+
+        auto r1 = gru1->forward(gated.view({1, k, -1}), h1);
+        auto out = std::get<0>(r1).view({k, -1});
+        out = out * hidden_size / (out.abs().sum(1, true).detach() + 1e-8) + gated;
+
+        return {out, std::get<1>(r0), std::get<1>(r1)};
+    }
 };
 TORCH_MODULE(Backbone);
 
@@ -141,7 +174,7 @@ struct RewardModelImpl : torch::nn::Module {
 
     int num_channels, grid_x, grid_y, hidden_size, num_actions;
 
-    RewardModelImpl(int num_channels = 32, int grid_x = 31, int grid_y = 31, int hidden_size = 160, int num_actions = 9)
+    RewardModelImpl(int num_channels = bot_schema::channels, int grid_x = bot_schema::side, int grid_y = bot_schema::side, int hidden_size = 160, int num_actions = 9)
         : num_channels(num_channels), grid_x(grid_x), grid_y(grid_y), hidden_size(hidden_size), num_actions(num_actions) {
         backbone = register_module("backbone", Backbone(num_channels, grid_x, grid_y, hidden_size, num_actions));
         value_head = register_module("value", torch::nn::Sequential(
@@ -262,15 +295,23 @@ public:
         return model;
     }
 
+    // trades the model's recurrent state with h, so agents sharing this network each keep their own
+    void swap_memory(torch::Tensor (&h)[2]) {
+        std::swap(model->backbone->h_state[0], h[0]);
+        std::swap(model->backbone->h_state[1], h[1]);
+    }
+
     void train_epoch(const std::vector<int> &actions,
-         const bool &manual, const std::vector<torch::Tensor> &states){
+         const bool &manual, const std::vector<sparse_obs> &states){
         time_t ts = time(0);
         outputs.clear(), targets.clear();
         model->reset_memory();
         for (int i = 0; i < T; ++i) {
             torch::Tensor one_hot = torch::zeros({num_actions});
             one_hot[actions[i]] += 1;
-            get_reward(one_hot, (i < T / 2 ? !manual : manual), states[i]);
+            auto state = torch::empty({1, num_channels, grid_x, grid_y});
+            states[i].densify(state.data_ptr<float>(), state.numel());
+            get_reward(one_hot, (i < T / 2 ? !manual : manual), state);
         }
         is_training = true;
         done_training = false;
@@ -290,7 +331,7 @@ private:
     std::thread trainThread;
     float learning_rate, alpha;
     int T;
-    const int num_actions = 9, num_channels = 32, grid_x = 31, grid_y = 31, hidden_size = 160;
+    const int num_actions = 9, num_channels = bot_schema::channels, grid_x = bot_schema::side, grid_y = bot_schema::side, hidden_size = 160;
     std::string backup_dir;
     RewardModel model{nullptr};
     std::unique_ptr<torch::optim::AdamW> optimizer{nullptr};
@@ -355,4 +396,5 @@ private:
         outputs.push_back(output);
         targets.push_back(target);
     }
-};
\ No newline at end of file
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+#include "ObsSchema.hpp"
+#include "SparseObs.hpp"
+
+// what the agents of bot-0.5, bot-1 and bot-1.1 see; Custom encodes it and the models take their
+// input shape from it
+using bot_schema = full_schema;
+
+// number of unpadded 3x3, stride 2 convolutions GameCNN stacks to bring a side x side window to
+// 1x1, or 0 when some step would leave a 2x2 map the next convolution can't cover
+constexpr int cnn_layers(int side){
+	int layers = 0;
+	for(; side > 1; ++layers){
+		if(side < 3)
+			return 0;
+		side = (side - 3) / 2 + 1;
+	}
+	return layers;
+}
+
+static_assert(cnn_layers(bot_schema::side) > 0, "GameCNN can't reduce a bot_schema window to 1x1");
+static_assert(sparse_obs::fits<bot_schema>, "bot_schema has too many features for 16-bit sparse positions");
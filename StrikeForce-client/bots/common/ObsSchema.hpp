@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+
+// every feature describe() can give a cell, in the order of the full observation
+enum obs_channel{
+	// object type: character, bullet, wall, chest, portal-in, portal-out, tmp
+	CH_CHARACTER, CH_BULLET, CH_WALL, CH_CHEST, CH_PORTAL_IN, CH_PORTAL_OUT, CH_TMP,
+	// character situation: ally, enemy, npc, zombie, kills, blocks, portals, holds a portal
+	CH_ALLY, CH_ENEMY, CH_NPC, CH_ZOMBIE, CH_KILLS, CH_BLOCKS, CH_PORTALS, CH_HOLDS_PORTAL,
+	// stops humans, stops bullets, destructible, Hp
+	CH_STOPS_HUMAN, CH_STOPS_BULLET, CH_DESTRUCTIBLE, CH_HP,
+	// is a bullet, attack vector, damage, effect, stamina
+	CH_IS_BULLET, CH_ATTACK_1, CH_ATTACK_2, CH_ATTACK_3, CH_ATTACK_4, CH_DAMAGE, CH_EFFECT, CH_STAMINA,
+	// consumable item: stamina, effect, Hp
+	CH_CONS_STAMINA, CH_CONS_EFFECT, CH_CONS_HP,
+	// damage and effect of the character's weapon
+	CH_HUMAN_DAMAGE, CH_HUMAN_EFFECT,
+	// the agent has a line of sight to the cell; a schema with it gets fog of war
+	CH_VISIBLE,
+	CH_COUNT
+};
+
+// how a channel is normalized: 1 binary {0, 1}, 2 small integer, 0 continuous
+constexpr int obs_kind(obs_channel c){
+	switch(c){
+		case CH_KILLS: case CH_BLOCKS: case CH_PORTALS:
+			return 2;
+		case CH_HP: case CH_ATTACK_1: case CH_ATTACK_2: case CH_ATTACK_3: case CH_ATTACK_4:
+		case CH_DAMAGE: case CH_EFFECT: case CH_STAMINA: case CH_CONS_STAMINA: case CH_CONS_EFFECT:
+		case CH_CONS_HP: case CH_HUMAN_DAMAGE: case CH_HUMAN_EFFECT:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+// at[c] is the plane of channel c in an observation, -1 if it isn't part of it
+struct obs_slots{
+	int at[CH_COUNT];
+};
+
+template<obs_channel... C>
+constexpr obs_slots slots_of(){
+	obs_slots res{};
+	for(int c = 0; c < CH_COUNT; ++c)
+		res.at[c] = -1;
+	obs_channel channel[] = {C...};
+	for(int i = 0; i < (int)sizeof...(C); ++i)
+		res.at[channel[i]] = i;
+	return res;
+}
+
+// what an agent sees: channels C of the (2 * RADIUS + 1)^2 cells around it, in CHW order.
+// the encoder only computes and stores these channels and the models take their shape from here
+template<int RADIUS, obs_channel... C>
+struct obs_schema{
+	static int constexpr radius = RADIUS, side = 2 * RADIUS + 1, cells = side * side;
+	static int constexpr channels = sizeof...(C), size = channels * cells;
+	static constexpr obs_channel channel[channels] = {C...};
+	static constexpr int kind[channels] = {obs_kind(C)...};
+	static constexpr obs_slots slot = slots_of<C...>();
+
+	static constexpr bool has(obs_channel c){
+		return slot.at[c] != -1;
+	}
+};
+
+using full_schema = obs_schema<15,
+	CH_CHARACTER, CH_BULLET, CH_WALL, CH_CHEST, CH_PORTAL_IN, CH_PORTAL_OUT, CH_TMP,
+	CH_ALLY, CH_ENEMY, CH_NPC, CH_ZOMBIE, CH_KILLS, CH_BLOCKS, CH_PORTALS, CH_HOLDS_PORTAL,
+	CH_STOPS_HUMAN, CH_STOPS_BULLET, CH_DESTRUCTIBLE, CH_HP,
+	CH_IS_BULLET, CH_ATTACK_1, CH_ATTACK_2, CH_ATTACK_3, CH_ATTACK_4, CH_DAMAGE, CH_EFFECT, CH_STAMINA,
+	CH_CONS_STAMINA, CH_CONS_EFFECT, CH_CONS_HP,
+	CH_HUMAN_DAMAGE, CH_HUMAN_EFFECT>;
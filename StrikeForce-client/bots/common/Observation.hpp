@@ -0,0 +1,602 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "../../gameplay.hpp"
+#include "ObsSchema.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Environment::Field{
+
+	// every feature x is normalized to (|x| / 10)^0.2; discrete channels read it from obs_lut,
+	// which holds the exact std::pow values of 0..255
+	std::vector<float> obs_lut = []{
+		std::vector<float> res(256);
+		for(int i = 0; i < 256; ++i)
+			res[i] = std::pow(std::abs((float)i) / 10, 0.2);
+		return res;
+	}();
+
+	// continuous channels use a bit-trick estimate refined by 4 Newton steps of r = (4r + y / r^4) / 5.
+	// against std::pow(std::abs(x) / 10, 0.2) the relative error stays below 2e-7 (under 2 float ulps)
+	// for |x| in [1e-30, 1e30], and 0 maps to exactly 0
+	inline float fifth_root(float x){
+		float y = std::abs(x) / 10;
+		if(y == 0)
+			return 0;
+		int i;
+		memcpy(&i, &y, 4);
+		i = i / 5 + 852282573;
+		float r;
+		memcpy(&r, &i, 4);
+		for(int k = 0; k < 4; ++k){
+			float r2 = r * r;
+			r = 0.8f * r + 0.2f * y / (r2 * r2);
+		}
+		return r;
+	}
+
+	// out[i] = fifth_root(in[i]) for i < n, 8 or 4 lanes at a time with AVX2 or NEON
+	void fifth_roots(const float *in, float *out, int n){
+		int i = 0;
+#if defined(__AVX2__)
+		const __m256 sign = _mm256_set1_ps(-0.0f), ten = _mm256_set1_ps(10.0f), zero = _mm256_setzero_ps();
+		const __m256 fifth = _mm256_set1_ps(0.2f), four_fifths = _mm256_set1_ps(0.8f), bias = _mm256_set1_ps(852282573.0f);
+		for(; i + 8 <= n; i += 8){
+			__m256 y = _mm256_div_ps(_mm256_andnot_ps(sign, _mm256_loadu_ps(in + i)), ten);
+			__m256i b = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(y)), fifth), bias));
+			__m256 r = _mm256_castsi256_ps(b);
+			for(int k = 0; k < 4; ++k){
+				__m256 r2 = _mm256_mul_ps(r, r);
+				r = _mm256_add_ps(_mm256_mul_ps(four_fifths, r), _mm256_div_ps(_mm256_mul_ps(fifth, y), _mm256_mul_ps(r2, r2)));
+			}
+			_mm256_storeu_ps(out + i, _mm256_and_ps(r, _mm256_cmp_ps(y, zero, _CMP_NEQ_OQ)));
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		const float32x4_t fifth = vdupq_n_f32(0.2f), four_fifths = vdupq_n_f32(0.8f), bias = vdupq_n_f32(852282573.0f);
+		for(; i + 4 <= n; i += 4){
+			float32x4_t y = vdivq_f32(vabsq_f32(vld1q_f32(in + i)), vdupq_n_f32(10.0f));
+			int32x4_t b = vcvtnq_s32_f32(vaddq_f32(vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_f32(y)), fifth), bias));
+			float32x4_t r = vreinterpretq_f32_s32(b);
+			for(int k = 0; k < 4; ++k){
+				float32x4_t r2 = vmulq_f32(r, r);
+				r = vaddq_f32(vmulq_f32(four_fifths, r), vdivq_f32(vmulq_f32(fifth, y), vmulq_f32(r2, r2)));
+			}
+			uint32x4_t nz = vmvnq_u32(vceqq_f32(y, vdupq_n_f32(0)));
+			vst1q_f32(out + i, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(r), nz)));
+		}
+#endif
+		for(; i < n; ++i)
+			out[i] = fifth_root(in[i]);
+		return;
+	}
+
+	inline float normalize(int kind, float x){
+		if(kind == 1)
+			return x != 0 ? obs_lut[1] : 0;
+		if(kind == 2 && 0 <= x && x < 256 && x == (int)x)
+			return obs_lut[(int)x];
+		return fifth_root(x);
+	}
+
+	// normalizes the raw features of one cell, stored contiguously, into out
+	template<typename S>
+	void normalize_cell(const float *raw, float *out){
+		fifth_roots(raw, out, S::channels);
+		for(int k = 0; k < S::channels; ++k)
+			if(S::kind[k])
+				out[k] = normalize(S::kind[k], raw[k]);
+		return;
+	}
+
+	// normalizes a whole CHW observation in place, a plane at a time
+	template<typename S>
+	void normalize_planes(float *obs){
+		for(int k = 0; k < S::channels; ++k){
+			float *p = obs + k * S::cells;
+			if(!S::kind[k])
+				fifth_roots(p, p, S::cells);
+			else
+				for(int i = 0; i < S::cells; ++i)
+					p[i] = normalize(S::kind[k], p[i]);
+		}
+		return;
+	}
+
+	// writes the raw features of cell seen by a member of team to out[0], out[plane], ..., out[(S::channels - 1) * plane]
+	template<typename S>
+	void describe(const node &cell, int team, float *out, int plane){
+		auto put = [&](obs_channel c, float x){
+			if(S::has(c))
+				out[S::slot.at[c] * plane] = x;
+			return;
+		};
+		// object type |Char bullet wall chest portal-in portal-out tmp| {0, 1}^7      | 7
+		put(CH_CHARACTER, cell.s[0] || cell.s[1]);
+		put(CH_BULLET, cell.s[2]); put(CH_WALL, cell.s[3]); put(CH_CHEST, cell.s[4]);
+		put(CH_PORTAL_IN, cell.s[5] || cell.s[6]);
+		put(CH_PORTAL_OUT, cell.s[7]); put(CH_TMP, cell.s[10]);
+		// character situation |khoodie, doshmane, npc, zombie| {0, 1}^4 N^3 {0, 1}    | 8
+		int t = cell.s[0] ? cell.human->get_team() : 0;
+		put(CH_ALLY, cell.s[0] && t && t == team);
+		put(CH_ENEMY, cell.s[0] && t && t != team);
+		put(CH_NPC, cell.s[0] && !t);
+		put(CH_ZOMBIE, cell.s[1]);
+		if(cell.s[0]){
+			put(CH_KILLS, cell.human->get_kills());
+			put(CH_BLOCKS, cell.human->backpack.get_blocks());
+			put(CH_PORTALS, cell.human->backpack.get_portals());
+			put(CH_HOLDS_PORTAL, cell.human->backpack.get_portal_ind() != -1);
+		}
+		else{
+			put(CH_KILLS, 0);
+			put(CH_BLOCKS, 0);
+			put(CH_PORTALS, 0);
+			put(CH_HOLDS_PORTAL, 0);
+		}
+		// it can't be passed through by human, bullet; can it destroyed by shooting, Hp {0, 1}^3 [0, inf)| 4
+		float sit[4] = {0, 0, 0, 0}, hp = 0;
+		if(cell.s[3] || cell.s[5] || cell.s[6] || cell.s[0] || cell.s[1]){
+			sit[0] = sit[1] = 1;
+			sit[2] = cell.s[10] || cell.s[0] || cell.s[1];
+			if(cell.s[0])
+				hp = cell.human->get_Hp() / 1000.0;
+			else if(cell.s[1])
+				hp = cell.zombie->get_Hp() / 1000.0;
+			else if(cell.s[10]){
+				if(cell.s[3])
+					hp = (lim_block - cell.dmg) / 1000.0;
+				else
+					hp = (lim_portal - cell.dmg) / 1000.0;
+			}
+		}
+		else if(cell.s[7])
+			sit[0] = 1;
+		put(CH_STOPS_HUMAN, sit[0]); put(CH_STOPS_BULLET, sit[1]); put(CH_DESTRUCTIBLE, sit[2]);
+		put(CH_HP, hp);
+		// is it a bullet, attack vector, damage effect stamina {0, 1} [0, 1]^4 [0, inf)^3 | 8
+		sit[0] = sit[1] = sit[2] = sit[3] = 0;
+		float damage = 0, effect = 0, is_bull = 0, estamina = 0;
+		if(cell.s[0]){
+			sit[cell.human->get_way() - 1] = 1;
+			if(S::has(CH_DAMAGE) || S::has(CH_EFFECT)){
+				auto [d, e] = cell.human->damage_effect();
+				damage = d / 1000.0;
+				effect = -e / 1000.0;
+			}
+			estamina = cell.human->get_stamina() / 1000.0;
+		}
+		else if(cell.s[1]){
+			sit[0] = sit[1] = sit[2] = sit[3] = 0.01;
+			damage = cell.zombie->get_mindamage() / 1000.0;
+		}
+		else if(cell.s[2]){
+			is_bull = 1;
+			sit[cell.bullet->get_way() - 1] = (cell.bullet->get_range() - cell.bullet->traveled()) / 100.0;
+			damage = cell.bullet->get_damage() / 1000.0;
+			effect = -cell.bullet->get_effect() / 1000.0;
+		}
+		else if(cell.s[7]){
+			damage = 20 / 1000.0;
+			effect = 10 / 1000.0;
+		}
+		put(CH_IS_BULLET, is_bull);
+		for(int i = 0; i < 4; ++i)
+			put(obs_channel(CH_ATTACK_1 + i), sit[i]);
+		put(CH_DAMAGE, damage), put(CH_EFFECT, effect), put(CH_STAMINA, estamina);
+		// Consumable items [0, inf)^3                                                     | 3
+		if(cell.s[4]){
+			put(CH_CONS_STAMINA, cell.cons->get_stamina() / 1000.0);
+			put(CH_CONS_EFFECT, cell.cons->get_effect() / 1000.0);
+			put(CH_CONS_HP, cell.cons->get_Hp() / 1000.0);
+		}
+		else{
+			put(CH_CONS_STAMINA, 0);
+			put(CH_CONS_EFFECT, 0);
+			put(CH_CONS_HP, 0);
+		}
+		// damage effect   [0, inf)^2                                                     | 2
+		if(cell.s[0]){
+			put(CH_HUMAN_DAMAGE, cell.human->get_damage() / 1000.0);
+			put(CH_HUMAN_EFFECT, -cell.human->get_effect() / 1000.0);
+		}
+		else{
+			put(CH_HUMAN_DAMAGE, 0);
+			put(CH_HUMAN_EFFECT, 0);
+		}
+		put(CH_VISIBLE, 1);
+		return;
+	}
+
+	std::vector<float> describe(const node &cell, const Environment::Character::Human &player){
+		std::vector<float> res(full_schema::channels);
+		describe<full_schema>(cell, player.get_team(), res.data(), 1);
+		return res;
+	}
+
+	// what a cell looked like when it was encoded; s[8] and s[9] don't reach the observation
+	struct cell_key{
+		int dmg = 0;
+		unsigned long bits = ~0ul;
+		const Environment::Item::ConsumableItem* cons = nullptr;
+
+		bool operator==(const cell_key &o) const{
+			return dmg == o.dmg && bits == o.bits && cons == o.cons;
+		}
+	};
+
+	// normalized features of a whole floor, padded by S::radius cells of nd on every side and shared
+	// by all agents on it. features are encoded for a member of no team, so a human with a team shows
+	// as an enemy; team keeps who is on each cell to patch allies in per agent
+	struct floor_plane{
+		int n = 0, m = 0;
+		std::vector<float> feat;
+		std::vector<int> team;
+		std::vector<cell_key> key;
+		std::vector<long long> seen;
+		// summed-area tables of feat, rebuilt on request once per frame: sat[k * (n + 1) * (m + 1) + x * (m + 1) + y]
+		// is the sum of channel k over padded cells [0, x) x [0, y); team_sat does the same for the humans of a team
+		std::vector<double> sat;
+		long long sat_tick = -1;
+		std::vector<std::pair<int, std::vector<int>>> team_sat;
+	};
+
+	// cells that block the line of sight: walls, blocks and portals
+	inline bool opaque(const node &cell){
+		return cell.s[3] || cell.s[5] || cell.s[6];
+	}
+
+	unsigned long constexpr opaque_bits = 1ul << 3 | 1ul << 5 | 1ul << 6;
+
+	template<typename S>
+	struct floor_planes{
+		static inline std::vector<floor_plane> planes;
+		static inline long long tick = 0, frame = -1, generation = 0, epoch = -1;
+		// opacity[chunk_id(f, i, j)] grows whenever a refreshed cell of that chunk turns opaque or clear
+		static inline std::vector<long long> opacity;
+
+		// the planes are rebuilt when the world is resized or a new match starts, so no stamp,
+		// key or fog mask of the previous match is taken for this one
+		static void fit(){
+			int r = S::radius;
+			if(epoch == match_epoch && (int)planes.size() == F && planes[0].n == N + 2 * r && planes[0].m == M + 2 * r)
+				return;
+			epoch = match_epoch;
+			planes.assign(F, floor_plane());
+			opacity.assign(F * CN * CM, 0);
+			++generation;
+			float raw[S::channels], f[S::channels];
+			describe<S>(nd, -1, raw, 1);
+			normalize_cell<S>(raw, f);
+			for(auto &e: planes){
+				e.n = N + 2 * r, e.m = M + 2 * r;
+				int area = e.n * e.m;
+				e.feat.resize(S::channels * area);
+				for(int k = 0; k < S::channels; ++k)
+					std::fill(e.feat.begin() + k * area, e.feat.begin() + (k + 1) * area, f[k]);
+				e.team.assign(area, -1);
+				e.key.assign(area, cell_key());
+				e.seen.assign(area, -1);
+			}
+			return;
+		}
+
+		static void begin(long long f){
+			fit();
+			if(f != frame)
+				frame = f, ++tick;
+			return;
+		}
+
+		// brings cells [x0, x1] x [y0, y1] of floor f up to date. each cell is checked once per frame and
+		// re-encoded only when its key changed or it holds a character or bullet, whose state may change
+		// without touching the cell
+		static void refresh(const grid<node> &map, int f, int x0, int x1, int y0, int y1){
+			int r = S::radius;
+			floor_plane &pl = planes[f];
+			int area = pl.n * pl.m;
+			for(int x = std::max(x0, 0); x <= std::min(x1, N - 1); ++x)
+				for(int y = std::max(y0, 0); y <= std::min(y1, M - 1); ++y){
+					int p = (x + r) * pl.m + y + r;
+					if(pl.seen[p] == tick)
+						continue;
+					pl.seen[p] = tick;
+					const node &cell = map[f][x][y];
+					cell_key k{cell.dmg, cell.s.to_ulong() & ~(3ul << 8), cell.s[4] ? cell.cons : nullptr};
+					if(!(k.bits & 7) && pl.key[p] == k)
+						continue;
+					if((pl.key[p].bits ^ k.bits) & opaque_bits)
+						++opacity[chunk_id(f, x, y)];
+					pl.key[p] = k;
+					pl.team[p] = cell.s[0] ? cell.human->get_team() : -1;
+					float raw[S::channels], v[S::channels];
+					describe<S>(cell, -1, raw, 1);
+					normalize_cell<S>(raw, v);
+					for(int i = 0; i < S::channels; ++i)
+						pl.feat[i * area + p] = v[i];
+				}
+			return;
+		}
+
+		// floor f with its summed-area tables of this frame
+		static floor_plane& summed(const grid<node> &map, int f){
+			floor_plane &pl = planes[f];
+			if(pl.sat_tick == tick)
+				return pl;
+			pl.sat_tick = tick;
+			pl.team_sat.clear();
+			refresh(map, f, 0, N - 1, 0, M - 1);
+			int area = pl.n * pl.m, w = pl.m + 1, sarea = (pl.n + 1) * w;
+			pl.sat.assign(S::channels * sarea, 0);
+			for(int k = 0; k < S::channels; ++k){
+				const float *src = pl.feat.data() + k * area;
+				double *dst = pl.sat.data() + k * sarea;
+				for(int x = 0; x < pl.n; ++x){
+					double row = 0;
+					for(int y = 0; y < pl.m; ++y){
+						row += src[x * pl.m + y];
+						dst[(x + 1) * w + y + 1] = dst[x * w + y + 1] + row;
+					}
+				}
+			}
+			return pl;
+		}
+
+		static const std::vector<int>& team_summed(floor_plane &pl, int team){
+			for(auto &e: pl.team_sat)
+				if(e.first == team)
+					return e.second;
+			int w = pl.m + 1;
+			std::vector<int> sat((pl.n + 1) * w, 0);
+			for(int x = 0; x < pl.n; ++x){
+				int row = 0;
+				for(int y = 0; y < pl.m; ++y){
+					row += pl.team[x * pl.m + y] == team;
+					sat[(x + 1) * w + y + 1] = sat[x * w + y + 1] + row;
+				}
+			}
+			pl.team_sat.emplace_back(team, std::move(sat));
+			return pl.team_sat.back().second;
+		}
+	};
+
+	// cells of the window around an agent it has a line of sight to, by recursive shadowcasting.
+	// a mask stays valid while the agent keeps its cell and no chunk under its window changes opacity
+	template<typename S>
+	struct fog_mask{
+		std::bitset<S::cells> visible;
+		int f = -1, x = 0, y = 0;
+		long long generation = -1, version = -1;
+
+		void cast(const grid<node> &map, int row, double start, double end, int xx, int xy, int yx, int yy){
+			if(start < end)
+				return;
+			double next = start;
+			for(int j = row; j <= S::radius; ++j){
+				bool blocked = false;
+				for(int dx = -j, dy = -j; dx <= 0; ++dx){
+					double l = (dx - 0.5) / (dy + 0.5), r = (dx + 0.5) / (dy - 0.5);
+					if(start < r)
+						continue;
+					if(end > l)
+						break;
+					int u = dx * xx + dy * xy, v = dx * yx + dy * yy, cx = x + u, cy = y + v;
+					visible[(u + S::radius) * S::side + v + S::radius] = 1;
+					bool wall = 0 <= cx && cx < N && 0 <= cy && cy < M && opaque(map[f][cx][cy]);
+					if(blocked){
+						if(wall)
+							next = r;
+						else{
+							blocked = false;
+							start = next;
+						}
+					}
+					else if(wall && j < S::radius){
+						blocked = true;
+						cast(map, j + 1, start, l, xx, xy, yx, yy);
+						next = r;
+					}
+				}
+				if(blocked)
+					break;
+			}
+			return;
+		}
+
+		void compute(const grid<node> &map){
+			static int constexpr mult[4][8] = {
+				{1, 0, 0, -1, -1, 0, 0, 1},
+				{0, 1, -1, 0, 0, -1, 1, 0},
+				{0, 1, 1, 0, 0, -1, -1, 0},
+				{1, 0, 0, 1, -1, 0, 0, -1}
+			};
+			visible.reset();
+			visible[S::radius * S::side + S::radius] = 1;
+			for(int o = 0; o < 8; ++o)
+				cast(map, 1, 1.0, 0.0, mult[0][o], mult[1][o], mult[2][o], mult[3][o]);
+			return;
+		}
+	};
+
+	template<typename S>
+	struct fog_masks{
+		static inline std::vector<fog_mask<S>> masks;
+		static inline long long computed = 0, reused = 0;
+
+		// mask of the agent at hum[i], recomputed only when it moved or the opacity around it changed.
+		// the cells of its window must have been refreshed this frame
+		static const fog_mask<S>& get(const grid<node> &map, int i){
+			using cache = floor_planes<S>;
+			if((int)masks.size() < hum.capacity())
+				masks.resize(hum.capacity());
+			const auto &c = hum.state(i).cor;
+			int r = S::radius;
+			long long version = 0;
+			for(int a = std::max(c[1] - r, 0) / CS; a <= std::min(c[1] + r, N - 1) / CS; ++a)
+				for(int b = std::max(c[2] - r, 0) / CS; b <= std::min(c[2] + r, M - 1) / CS; ++b)
+					version += cache::opacity[chunk_id(c[0], a * CS, b * CS)];
+			fog_mask<S> &e = masks[i];
+			if(e.f == c[0] && e.x == c[1] && e.y == c[2] && e.generation == cache::generation && e.version == version){
+				++reused;
+				return e;
+			}
+			e.f = c[0], e.x = c[1], e.y = c[2], e.generation = cache::generation, e.version = version;
+			e.compute(map);
+			++computed;
+			return e;
+		}
+	};
+
+	// zeroes every channel of the window cells the agent has no line of sight to
+	template<typename S>
+	void hide_unseen(const std::bitset<S::cells> &visible, float *out){
+		for(int p = 0; p < S::cells; ++p)
+			if(!visible[p])
+				for(int k = 0; k < S::channels; ++k)
+					out[k * S::cells + p] = 0;
+		return;
+	}
+
+	// writes the observation of player on map to out, which holds S::size floats; allocates nothing.
+	// the fog mask, if S has one, is cast afresh since nothing here is cached
+	template<typename S>
+	void encode(const grid<node> &map, const Environment::Character::Human &player, float *out){
+		const auto &c = player.state().cor;
+		int r = S::radius;
+		for(int i = 0; i < S::side; ++i)
+			for(int j = 0; j < S::side; ++j){
+				int x = c[1] - r + i, y = c[2] - r + j;
+				if(x < 0 || y < 0 || N <= x || M <= y)
+					describe<S>(nd, player.get_team(), out + i * S::side + j, S::cells);
+				else
+					describe<S>(map[c[0]][x][y], player.get_team(), out + i * S::side + j, S::cells);
+			}
+		normalize_planes<S>(out);
+		if constexpr(S::has(CH_VISIBLE)){
+			fog_mask<S> mask;
+			mask.f = c[0], mask.x = c[1], mask.y = c[2];
+			mask.compute(map);
+			hide_unseen<S>(mask.visible, out);
+		}
+		return;
+	}
+
+	// an agent to observe and the map it plays on
+	struct obs_job{
+		const grid<node> *map;
+		const Environment::Character::Human *player;
+	};
+
+	// observation k of jobs goes to out + k * S::size, so out can back a [K, channels, side, side] tensor
+	// for one forward call. maps must have the size of the running one
+	template<typename S>
+	void encode_batch(const std::vector<obs_job> &jobs, float *out){
+		for(size_t i = 0; i < jobs.size(); ++i)
+			encode<S>(*jobs[i].map, *jobs[i].player, out + (long long)i * S::size);
+		return;
+	}
+
+	// sum of a summed-area table t with rows of width w over [x0, x1) x [y0, y1)
+	template<typename T>
+	T rect_sum(const T *t, int w, int x0, int y0, int x1, int y1){
+		return t[x1 * w + y1] - t[x0 * w + y1] - t[x1 * w + y0] + t[x0 * w + y0];
+	}
+
+	// like encode(map, player, out), but reads the window from the shared plane of its floor
+	template<typename S>
+	void encode(const grid<node> &map, const Environment::Character::Human &player, long long frame, float *out){
+		using cache = floor_planes<S>;
+		cache::begin(frame);
+		const auto &c = player.state().cor;
+		int r = S::radius;
+		cache::refresh(map, c[0], c[1] - r, c[1] + r, c[2] - r, c[2] + r);
+		floor_plane &pl = cache::planes[c[0]];
+		int area = pl.n * pl.m;
+		for(int k = 0; k < S::channels; ++k)
+			for(int i = 0; i < S::side; ++i){
+				const float *row = pl.feat.data() + k * area + (c[1] + i) * pl.m + c[2];
+				std::copy(row, row + S::side, out + k * S::cells + i * S::side);
+			}
+		int team = player.state().team;
+		if(team > 0 && (S::has(CH_ALLY) || S::has(CH_ENEMY)))
+			for(int i = 0; i < S::side; ++i){
+				const int *row = pl.team.data() + (c[1] + i) * pl.m + c[2];
+				for(int j = 0; j < S::side; ++j)
+					if(row[j] == team){
+						if(S::has(CH_ALLY))
+							out[S::slot.at[CH_ALLY] * S::cells + i * S::side + j] = obs_lut[1];
+						if(S::has(CH_ENEMY))
+							out[S::slot.at[CH_ENEMY] * S::cells + i * S::side + j] = 0;
+					}
+			}
+		if constexpr(S::has(CH_VISIBLE))
+			hide_unseen<S>(fog_masks<S>::get(map, hum.index_of(&player)).visible, out);
+		return;
+	}
+
+	// coarse view around player to go with the fine window: blocks x blocks squares of block x block
+	// cells centred on it, each holding the mean of every channel over its cells (S::channels x blocks
+	// x blocks floats, CHW). cells past the map count as the empty padding of the window, and
+	// squares wholly outside the padded floor are 0. each square costs O(S::channels) through the
+	// summed-area tables of the floor, so the cost doesn't depend on the map size. squares reach past
+	// the window a fog mask covers, so schemas with CH_VISIBLE can't be encoded coarsely
+	template<typename S>
+	void encode_coarse(const grid<node> &map, const Environment::Character::Human &player, long long frame, int blocks, int block, float *out){
+		static_assert(!S::has(CH_VISIBLE), "encode_coarse has no line of sight past the window");
+		using cache = floor_planes<S>;
+		cache::begin(frame);
+		const auto &c = player.state().cor;
+		floor_plane &pl = cache::summed(map, c[0]);
+		int w = pl.m + 1, sarea = (pl.n + 1) * w, cells = blocks * blocks, team = player.state().team;
+		const std::vector<int> *mates = nullptr;
+		if(team > 0 && (S::has(CH_ALLY) || S::has(CH_ENEMY)))
+			mates = &cache::team_summed(pl, team);
+		int cx = c[1] + S::radius - (blocks / 2) * block - block / 2, cy = c[2] + S::radius - (blocks / 2) * block - block / 2;
+		for(int a = 0; a < blocks; ++a)
+			for(int b = 0; b < blocks; ++b){
+				int x0 = std::max(cx + a * block, 0), x1 = std::min(cx + (a + 1) * block, pl.n);
+				int y0 = std::max(cy + b * block, 0), y1 = std::min(cy + (b + 1) * block, pl.m);
+				int p = a * blocks + b;
+				if(x1 <= x0 || y1 <= y0){
+					for(int k = 0; k < S::channels; ++k)
+						out[k * cells + p] = 0;
+					continue;
+				}
+				double area = (x1 - x0) * (y1 - y0);
+				for(int k = 0; k < S::channels; ++k)
+					out[k * cells + p] = rect_sum(pl.sat.data() + k * sarea, w, x0, y0, x1, y1) / area;
+				if(mates){
+					double ally = rect_sum(mates->data(), w, x0, y0, x1, y1) * obs_lut[1] / area;
+					if(S::has(CH_ALLY))
+						out[S::slot.at[CH_ALLY] * cells + p] += ally;
+					if(S::has(CH_ENEMY))
+						out[S::slot.at[CH_ENEMY] * cells + p] -= ally;
+				}
+			}
+		return;
+	}
+}
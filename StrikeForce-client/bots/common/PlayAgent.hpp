@@ -0,0 +1,185 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+#include "PolicyEngine.hpp"
+#include "PolicyFile.hpp"
+#include <map>
+#include <memory>
+#include <random>
+
+// the play-only Agent of INFERENCE_ONLY builds: the bot's trained policy runs on policy_engine
+// from the policy.sfw that a libtorch build exports next to model.pt, so the client links no
+// libtorch. it has the Agent interface the game and Custom use, and never trains
+
+// observations for Custom to encode into, laid out as the tensor of a libtorch build. it points
+// into the input buffer of the agent that made it
+struct obs_batch {
+    float* data;
+
+    template<typename T>
+    T* data_ptr() {
+        return data;
+    }
+};
+
+// the engine every agent playing from one backup_dir shares
+struct PolicyPool {
+    policy_engine engine;
+    bool loaded = false;
+
+    explicit PolicyPool(const std::string &backup_dir) {
+        policy_file file;
+        std::string path = backup_dir + "/policy.sfw";
+        if (file.open(path)) {
+            auto &h = file.header();
+            loaded = h.channels == bot_schema::channels && h.side == bot_schema::side &&
+                engine.load(h.channels, h.side, h.hidden, h.actions, [&](const std::string& name) { return file.find(name); });
+        }
+        if (!loaded)
+            std::cout << "no usable policy at " << path << ", agents stand still (run a libtorch build once to export it)" << std::endl;
+    }
+
+    // the pools in use by backup_dir, kept while no agent holds them until the match ends
+    static std::map<std::string, std::shared_ptr<PolicyPool>>& pools() {
+        static std::map<std::string, std::shared_ptr<PolicyPool>> res;
+        return res;
+    }
+
+    // the pool of backup_dir, loaded by the first agent that asks for it
+    static std::shared_ptr<PolicyPool> get(const std::string &backup_dir) {
+        auto &pool = pools()[backup_dir];
+        if (!pool)
+            pool = std::make_shared<PolicyPool>(backup_dir);
+        return pool;
+    }
+
+    // lets go of the pools no agent holds any more
+    static void end_match() {
+        auto &all = pools();
+        for (auto it = all.begin(); it != all.end();)
+            it = it->second.use_count() == 1 ? all.erase(it) : std::next(it);
+    }
+};
+
+class Agent {
+public:
+    Agent(const std::string &backup_dir = backup_path + "/agent_backup") : pool(PolicyPool::get(backup_dir)) {
+        if (pool->loaded)
+            num_actions = pool->engine.actions;
+        h_state[0].assign(pool->engine.hidden, 0);
+        h_state[1].assign(pool->engine.hidden, 0);
+        action_input.assign(num_actions, 0);
+        action_input[0] = 1;
+    }
+
+    obs_batch new_state() {
+        return new_states(1);
+    }
+
+    obs_batch new_states(int k) {
+        if (input.size() < (size_t)k * bot_schema::size)
+            input.resize((size_t)k * bot_schema::size);
+        return {input.data()};
+    }
+
+    // called when a match ends; an INFERENCE_ONLY agent learns nothing, so there is nothing to save
+    static void end_match() {
+        PolicyPool::end_match();
+    }
+
+    int predict(const obs_batch& state) {
+        return predict_batch({this}, state)[0];
+    }
+
+    // a decision for each of agents, where row i of states is what agents[i] sees. agents sharing a
+    // pool go through its engine in one step_batch, each with its own recurrent state as a row
+    static std::vector<int> predict_batch(const std::vector<Agent*>& agents, const obs_batch& states) {
+        std::vector<int> res(agents.size(), 0), rows;
+        for (int i = 0; i < (int)agents.size(); ++i)
+            if (agents[i]->pool->loaded)
+                rows.push_back(i);
+        std::vector<float> x, p, v;
+        while (!rows.empty()) {
+            std::vector<int> group, rest;
+            for (int i: rows)
+                (agents[i]->pool == agents[rows[0]]->pool ? group : rest).push_back(i);
+            rows.swap(rest);
+            const policy_engine& engine = agents[group[0]]->pool->engine;
+            int k = group.size(), A = engine.actions;
+            const float* xs = states.data;
+            if (k < (int)agents.size()) {
+                x.resize((size_t)k * bot_schema::size);
+                for (int r = 0; r < k; ++r)
+                    std::copy_n(&states.data[(size_t)group[r] * bot_schema::size], bot_schema::size, &x[(size_t)r * bot_schema::size]);
+                xs = x.data();
+            }
+            std::vector<float*> h0, h1;
+            std::vector<const float*> a;
+            for (int i: group) {
+                h0.push_back(agents[i]->h_state[0].data());
+                h1.push_back(agents[i]->h_state[1].data());
+                a.push_back(agents[i]->action_input.data());
+            }
+            p.resize((size_t)k * A), v.resize(k);
+            engine.step_batch(k, xs, bot_schema::size, h0.data(), h1.data(), a.data(), p.data(), v.data());
+            for (int r = 0; r < k; ++r)
+                res[group[r]] = agents[group[r]]->sample(&p[(size_t)r * A]);
+        }
+        return res;
+    }
+
+    void update(int action, bool) {
+        if (action < 0 || action >= num_actions)
+            return;
+        std::fill(action_input.begin(), action_input.end(), 0.0f);
+        action_input[action] = 1;
+    }
+
+    bool is_manual() {
+        return false;
+    }
+
+    bool in_training() {
+        return false;
+    }
+
+private:
+    std::shared_ptr<PolicyPool> pool;
+    int num_actions = 9;
+    std::vector<float> h_state[2], action_input, input;
+    std::mt19937 gen{std::random_device{}()};
+
+    // draws an action from the policy's probabilities p, as the libtorch Agent does
+    int sample(const float* p) {
+        std::vector<float> v(p, p + num_actions);
+#if !defined(SLOWMOTION)
+        for (int i = 1; i < num_actions; ++i)
+            v[i] *= 0.5f / (1 - v[0] + 1e-5f);
+        v[0] = 0.5f;
+#endif
+        std::discrete_distribution<> dist(v.begin(), v.end());
+        return dist(gen);
+    }
+};
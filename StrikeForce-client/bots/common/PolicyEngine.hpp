@@ -0,0 +1,598 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// a fully connected layer packed for policy_engine: w[k * ld + o] is the weight from input k to
+// output o, where ld is the output count rounded up to whole 8-float blocks (the padding is 0).
+// after quantize() the weight is q[k * ld + o] * scale[o] instead, and w is empty
+struct packed_dense {
+    int in = 0, out = 0, ld = 0;
+    std::vector<float> w, b, scale;
+    std::vector<int8_t> q;
+    // while set, apply() copies its input rows here, up to trace_rows of them (see policy_engine::quantize)
+    std::vector<float>* trace = nullptr;
+    size_t trace_rows = 0;
+
+    // from a row-major [out][in] weight as libtorch keeps it; input k reads column order[k] if given
+    void pack(const float* weight, const float* bias, int out, int in, const std::vector<int>& order = {}) {
+        this->in = in, this->out = out, ld = (out + 7) / 8 * 8;
+        w.assign((size_t)in * ld, 0);
+        b.assign(ld, 0);
+        q.clear(), scale.clear();
+        for (int o = 0; o < out; ++o) {
+            for (int k = 0; k < in; ++k)
+                w[(size_t)k * ld + o] = weight[(size_t)o * in + (order.empty() ? k : order[k])];
+            if (bias)
+                b[o] = bias[o];
+        }
+    }
+
+    // int8 weights with one scale per output: the output's largest |weight| / 127, times a clip.
+    // given sample inputs xs (rows of in floats), each output takes the clip whose rounding error,
+    // run over the samples as a layer of its own, moves that output least; without samples nothing
+    // is clipped
+    void quantize(const std::vector<float>& xs) {
+        const float clips[] = {1, 0.9f, 0.8f, 0.7f, 0.6f, 0.5f, 0.4f};
+        int n = xs.size() / in;
+        std::vector<float> mx(ld, 0), best(ld, -1), e((size_t)n * ld);
+        for (int k = 0; k < in; ++k)
+            for (int o = 0; o < out; ++o)
+                mx[o] = std::max(mx[o], std::abs(w[(size_t)k * ld + o]));
+        scale.assign(ld, 0);
+        packed_dense err;
+        err.in = in, err.out = out, err.ld = ld, err.b.assign(ld, 0);
+        std::vector<int> nz;
+        for (float c: clips) {
+            err.w = w;
+            for (int k = 0; k < in; ++k)
+                for (int o = 0; o < out; ++o)
+                    if (mx[o] > 0)
+                        err.w[(size_t)k * ld + o] -= mx[o] * c / 127 * to_int8(w[(size_t)k * ld + o] / (mx[o] * c / 127));
+            err.apply(xs.data(), n, in, e.data(), ld, nz);
+            for (int o = 0; o < out; ++o) {
+                double sum = 0;
+                for (int i = 0; i < n; ++i)
+                    sum += (double)e[(size_t)i * ld + o] * e[(size_t)i * ld + o];
+                if (best[o] < 0 || sum < best[o])
+                    best[o] = sum, scale[o] = mx[o] * c / 127;
+            }
+            if (!n)
+                break;
+        }
+        q.assign(w.size(), 0);
+        for (int k = 0; k < in; ++k)
+            for (int o = 0; o < out; ++o)
+                if (scale[o] > 0)
+                    q[(size_t)k * ld + o] = to_int8(w[(size_t)k * ld + o] / scale[o]);
+        std::vector<float>().swap(w);
+    }
+
+    // bytes taken by the weights, biases and scales
+    size_t bytes() const {
+        return (w.size() + b.size() + scale.size()) * sizeof(float) + q.size();
+    }
+
+    // y[o] = b[o] + sum of x[k] * w[k * ld + o] for all ld outputs, skipping the zero x[k]
+    void apply(const float* x, float* y, std::vector<int>& nz) const {
+        apply(x, 1, in, y, ld, nz);
+    }
+
+    // the same for rows inputs x + r * xs into y + r * ys. rows go 3 at a time with 32 outputs of
+    // each in registers, so every weight loaded serves 3 rows, and inputs that are zero in all 3
+    // rows are skipped, which makes the first convolution over a mostly empty observation cheap
+    void apply(const float* x, int rows, size_t xs, float* y, size_t ys, std::vector<int>& nz) const {
+        for (int r = 0; r < rows && trace && trace->size() < trace_rows * in; ++r)
+            trace->insert(trace->end(), x + r * xs, x + r * xs + in);
+        for (int r = 0; r < rows; r += 3) {
+            int n = std::min(3, rows - r);
+            const float* xr = x + r * xs;
+            nz.clear();
+            for (int k = 0; k < in; ++k)
+                if (xr[k] != 0 || (n > 1 && xr[xs + k] != 0) || (n > 2 && xr[2 * xs + k] != 0))
+                    nz.push_back(k);
+            if (q.empty())
+                rows_of(w.data(), n, xr, xs, y + r * ys, ys, nz);
+            else
+                rows_of(q.data(), n, xr, xs, y + r * ys, ys, nz);
+        }
+    }
+
+private:
+    static int8_t to_int8(float v) {
+        return (int8_t)std::max(-127.0f, std::min(127.0f, std::round(v)));
+    }
+
+    template<typename W>
+    void rows_of(const W* wt, int n, const float* x, size_t xs, float* y, size_t ys, const std::vector<int>& nz) const {
+        if (n == 3)
+            block<3>(wt, x, xs, y, ys, nz);
+        else if (n == 2)
+            block<2>(wt, x, xs, y, ys, nz);
+        else
+            block<1>(wt, x, xs, y, ys, nz);
+    }
+
+    // the vector registers block() works in: width floats each, 4 of them per row
+#if defined(__AVX2__)
+#define PACKED_DENSE_SIMD
+    using lanes = __m256;
+    static constexpr int width = 8;
+    static lanes splat(float v) { return _mm256_set1_ps(v); }
+    static lanes load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, lanes v) { _mm256_storeu_ps(p, v); }
+#if defined(__FMA__)
+    static lanes madd(lanes a, lanes b, lanes c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    static lanes madd(lanes a, lanes b, lanes c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    static void load4(const float* p, lanes (&v)[4]) {
+        v[0] = load(p), v[1] = load(p + 8), v[2] = load(p + 16), v[3] = load(p + 24);
+    }
+    static void load4(const int8_t* p, lanes (&v)[4]) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)p), hi = _mm_loadu_si128((const __m128i*)(p + 16));
+        v[0] = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(lo));
+        v[1] = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(lo, 8)));
+        v[2] = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(hi));
+        v[3] = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(hi, 8)));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define PACKED_DENSE_SIMD
+    using lanes = float32x4_t;
+    static constexpr int width = 4;
+    static lanes splat(float v) { return vdupq_n_f32(v); }
+    static lanes load(const float* p) { return vld1q_f32(p); }
+    static void store(float* p, lanes v) { vst1q_f32(p, v); }
+    static lanes madd(lanes a, lanes b, lanes c) { return vfmaq_f32(c, a, b); }
+    static void load4(const float* p, lanes (&v)[4]) {
+        v[0] = load(p), v[1] = load(p + 4), v[2] = load(p + 8), v[3] = load(p + 12);
+    }
+    static void load4(const int8_t* p, lanes (&v)[4]) {
+        int8x16_t q = vld1q_s8(p);
+        int16x8_t lo = vmovl_s8(vget_low_s8(q)), hi = vmovl_s8(vget_high_s8(q));
+        v[0] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo)));
+        v[1] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo)));
+        v[2] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi)));
+        v[3] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi)));
+    }
+#elif defined(__SSE2__)
+#define PACKED_DENSE_SIMD
+    using lanes = __m128;
+    static constexpr int width = 4;
+    static lanes splat(float v) { return _mm_set1_ps(v); }
+    static lanes load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, lanes v) { _mm_storeu_ps(p, v); }
+    static lanes madd(lanes a, lanes b, lanes c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static void load4(const float* p, lanes (&v)[4]) {
+        v[0] = load(p), v[1] = load(p + 4), v[2] = load(p + 8), v[3] = load(p + 12);
+    }
+    // SSE2 has no sign extension, so each byte is doubled into a wider lane and shifted back down
+    static void load4(const int8_t* p, lanes (&v)[4]) {
+        __m128i q = _mm_loadu_si128((const __m128i*)p);
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(q, q), 8), hi = _mm_srai_epi16(_mm_unpackhi_epi8(q, q), 8);
+        v[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16));
+        v[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16));
+        v[2] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16));
+        v[3] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16));
+    }
+#endif
+
+    // R rows of y from the weights wt (w or q): float weights start from b, int8 ones sum x * q
+    // and finish with b + scale * sum
+    template<int R, typename W>
+    void block(const W* wt, const float* x, size_t xs, float* y, size_t ys, const std::vector<int>& nz) const {
+        constexpr bool int8 = std::is_same<W, int8_t>::value;
+        int o = 0;
+#if defined(PACKED_DENSE_SIMD)
+        for (; o + 4 * width <= ld; o += 4 * width) {
+            lanes acc[R][4];
+#pragma GCC unroll 3
+            for (int r = 0; r < R; ++r)
+#pragma GCC unroll 4
+                for (int j = 0; j < 4; ++j)
+                    acc[r][j] = int8 ? splat(0) : load(&b[o + width * j]);
+            for (int k: nz) {
+                lanes wv[4];
+                load4(wt + (size_t)k * ld + o, wv);
+#pragma GCC unroll 3
+                for (int r = 0; r < R; ++r) {
+                    lanes xk = splat(x[r * xs + k]);
+#pragma GCC unroll 4
+                    for (int j = 0; j < 4; ++j)
+                        acc[r][j] = madd(xk, wv[j], acc[r][j]);
+                }
+            }
+#pragma GCC unroll 3
+            for (int r = 0; r < R; ++r)
+#pragma GCC unroll 4
+                for (int j = 0; j < 4; ++j)
+                    store(y + r * ys + o + width * j, int8 ? madd(acc[r][j], load(&scale[o + width * j]), load(&b[o + width * j])) : acc[r][j]);
+        }
+#endif
+        int o0 = o;
+        for (int r = 0; r < R; ++r) {
+            float* yr = y + r * ys;
+            for (o = o0; o < ld; ++o)
+                yr[o] = int8 ? 0 : b[o];
+            for (int k: nz)
+                for (o = o0; o < ld; ++o)
+                    yr[o] += x[r * xs + k] * wt[(size_t)k * ld + o];
+            if (int8)
+                for (o = o0; o < ld; ++o)
+                    yr[o] = b[o] + scale[o] * yr[o];
+        }
+    }
+};
+
+// how an engine with int8 weights did against its fp32 weights over a run of observations: the
+// share of steps where both pick the same most likely action, the mean KL(fp32 || int8) of the
+// action probabilities and the largest value difference
+struct quant_report {
+    int steps = 0;
+    double agreement = 0, kl = 0, value_err = 0;
+    size_t fp32_bytes = 0, int8_bytes = 0;
+};
+
+// the Backbone + ResB policy of bot-0.5 and bot-1 run from packed weights without libtorch. the
+// convolutions have no bias and no activation between them, so load() folds the whole stack into
+// one packed_dense from the CHW observation to the backbone features, and a step only touches the
+// rows of its non-zero observation cells. the GRUs and heads are packed_dense layers too, and every
+// L1 rescale is a pass over a vector that is still in cache. step_batch() runs each layer once over
+// all its rows, in scratch buffers of the engine, so one engine serves one thread at a time
+struct policy_engine {
+    int channels = 0, side = 0, hidden = 0, actions = 0;
+    // floats between two rows of a scratch buffer: enough for any layer's ld and for combined's input
+    int row = 0;
+    std::vector<packed_dense> value_res, policy_res;
+    packed_dense cnn, gru_ih[2], gru_hh[2], combined, value_out, policy_out;
+
+    // a weight by its libtorch name ("backbone.cnn.conv0.weight", ...), row-major as libtorch keeps
+    // it, or nullptr if the model has no such parameter
+    using weight_source = std::function<const float*(const std::string&)>;
+
+    // packs every layer; false if a weight is missing or the convolutions don't end at 1x1
+    bool load(int channels, int side, int hidden, int actions, const weight_source& get) {
+        this->channels = channels, this->side = side, this->hidden = hidden, this->actions = actions;
+        value_res.clear(), policy_res.clear();
+        if (!fold(get))
+            return false;
+        for (int i = 0; i < 2; ++i) {
+            std::string g = "backbone.gru" + std::to_string(i) + ".";
+            const float *wi = get(g + "weight_ih_l0"), *wh = get(g + "weight_hh_l0"), *bi = get(g + "bias_ih_l0"), *bh = get(g + "bias_hh_l0");
+            if (!wi || !wh || !bi || !bh)
+                return false;
+            gru_ih[i].pack(wi, bi, 3 * hidden, hidden);
+            gru_hh[i].pack(wh, bh, 3 * hidden, hidden);
+        }
+        const float *cw = get("backbone.combined_processor.0.weight"), *cb = get("backbone.combined_processor.0.bias");
+        if (!cw || !cb)
+            return false;
+        combined.pack(cw, cb, hidden, hidden + 5 * channels + actions);
+        if (!load_head("value", 1, value_res, value_out, get) || !load_head("policy", actions, policy_res, policy_out, get))
+            return false;
+        row = hidden + 5 * channels + actions;
+        for (auto l: layers())
+            row = std::max(row, l->ld);
+        for (auto &e: vec)
+            e.assign(row, 0);
+        return true;
+    }
+
+    // the same from a libtorch AgentModel; only torch builds instantiate it, so this header needs no libtorch
+    template<typename Model>
+    bool load(const Model& model) {
+        auto params = model->named_parameters();
+        std::vector<std::decay_t<decltype(params.begin()->value())>> keep;
+        return load(model->num_channels, model->grid_x, model->hidden_size, model->num_actions, [&](const std::string& name) -> const float* {
+            auto p = params.find(name);
+            if (!p)
+                return nullptr;
+            keep.push_back(p->contiguous());
+            return keep.back().template data_ptr<float>();
+        });
+    }
+
+    // one decision as AgentModel::forward makes it: x is a CHW observation, h0 and h1 the GRU states
+    // (updated in place) and a the one-hot last action. writes the action probabilities to p and the
+    // value to v
+    void step(const float* x, float* h0, float* h1, const float* a, float* p, float* v) const {
+        step_batch(1, x, 0, &h0, &h1, &a, p, v);
+    }
+
+    // k decisions at once: row r reads the observation x + r * xs, the GRU states h0[r] and h1[r] and
+    // the last action a[r], and writes p + r * actions and v[r]. every layer runs once over the k rows,
+    // so a weight loaded serves up to 3 rows instead of one
+    void step_batch(int k, const float* x, size_t xs, float* const* h0, float* const* h1, const float* const* a, float* p, float* v) const {
+        int S = side, C = channels, H = hidden, R = row, n = 5 * C + actions;
+        for (auto &e: vec)
+            if (e.size() < (size_t)k * R)
+                e.resize((size_t)k * R);
+        float *feat = vec[0].data(), *seq = vec[1].data(), *pov = vec[2].data(), *gated = vec[3].data(), *out = vec[4].data();
+        cnn.apply(x, k, xs, feat, R, nz);
+        for (int r = 0; r < k; ++r) {
+            rescale(feat + r * R, H, H);
+            memcpy(seq + r * R, h0[r], H * sizeof(float));
+        }
+        gru(0, k, feat, seq);
+
+        const int d[5][2] = {{-1, 0}, {0, -1}, {0, 0}, {0, 1}, {1, 0}};
+        for (int r = 0; r < k; ++r) {
+            float *sr = seq + r * R, *fr = feat + r * R, *pr = pov + r * R, *o = out + r * R;
+            const float* xr = x + r * xs;
+            memcpy(h0[r], sr, H * sizeof(float));
+            rescale(sr, H, H);
+            int m = 0;
+            for (auto &e: d)
+                for (int j = 0; j < C; ++j)
+                    pr[m++] = xr[(size_t)j * S * S + (S / 2 + e[0]) * S + S / 2 + e[1]];
+            for (int j = 0; j < actions; ++j)
+                pr[m++] = a[r][j];
+            rescale(pr, n, H);
+            for (int j = 0; j < H; ++j)
+                o[j] = sr[j] + fr[j];
+            memcpy(o + H, pr, n * sizeof(float));
+        }
+        combined.apply(out, k, R, gated, R, nz);
+        for (int r = 0; r < k; ++r) {
+            rescale(gated + r * R, H, H);
+            memcpy(out + r * R, h1[r], H * sizeof(float));
+        }
+
+        gru(1, k, gated, out);
+        for (int r = 0; r < k; ++r) {
+            float *o = out + r * R, *g = gated + r * R;
+            memcpy(h1[r], o, H * sizeof(float));
+            rescale(o, H, H);
+            for (int j = 0; j < H; ++j)
+                o[j] += g[j];
+        }
+
+        head(value_res, value_out, k, out, v, 1);
+        for (int r = 0; r < k; ++r)
+            v[r] = 1 / (1 + std::exp(-v[r]));
+        head(policy_res, policy_out, k, out, p, actions);
+        for (int r = 0; r < k; ++r) {
+            float *pr = p + r * actions, mx = pr[0], sum = 0;
+            for (int j = 1; j < actions; ++j)
+                mx = std::max(mx, pr[j]);
+            for (int j = 0; j < actions; ++j)
+                sum += pr[j] = std::exp(pr[j] - mx);
+            for (int j = 0; j < actions; ++j)
+                pr[j] = pr[j] / sum + 1e-8f;
+        }
+    }
+
+    // every packed_dense of the engine
+    std::vector<packed_dense*> layers() {
+        std::vector<packed_dense*> res{&cnn, &gru_ih[0], &gru_hh[0], &gru_ih[1], &gru_hh[1], &combined, &value_out, &policy_out};
+        for (auto &l: value_res)
+            res.push_back(&l);
+        for (auto &l: policy_res)
+            res.push_back(&l);
+        return res;
+    }
+
+    size_t bytes() {
+        size_t res = 0;
+        for (auto l: layers())
+            res += l->bytes();
+        return res;
+    }
+
+    // plays obs (CHW observations, in the order one agent saw them) from a zero memory. each step's
+    // probabilities go to p and its value to v; the action fed back is acts[t], or the most likely
+    // one (appended to acts) if acts comes empty
+    void play(const std::vector<const float*>& obs, std::vector<float>& p, std::vector<float>& v, std::vector<int>& acts) const {
+        std::vector<float> h0(hidden), h1(hidden), a(actions);
+        bool choose = acts.empty();
+        p.resize(obs.size() * actions), v.resize(obs.size());
+        a[0] = 1;
+        for (size_t t = 0; t < obs.size(); ++t) {
+            float* pt = &p[t * actions];
+            step(obs[t], h0.data(), h1.data(), a.data(), pt, &v[t]);
+            if (choose)
+                acts.push_back(std::max_element(pt, pt + actions) - pt);
+            std::fill(a.begin(), a.end(), 0.0f);
+            a[acts[t]] = 1;
+        }
+    }
+
+    // switches every layer to int8 weights with per-output scales, calibrated on obs: the fp32
+    // engine plays them and the inputs each layer got are its samples for packed_dense::quantize.
+    // then the int8 engine plays them with the fp32 actions for report. keeps fp32 and returns
+    // false if the two agree on fewer than min_agreement of the steps
+    bool quantize(const std::vector<const float*>& obs, double min_agreement, quant_report& report) {
+        policy_engine fp32 = *this;
+        auto ls = layers();
+        std::vector<std::vector<float>> samples(ls.size());
+        for (size_t i = 0; i < ls.size(); ++i)
+            ls[i]->trace = &samples[i], ls[i]->trace_rows = 128;
+        std::vector<float> p32, v32, p8, v8;
+        std::vector<int> acts;
+        play(obs, p32, v32, acts);
+        for (size_t i = 0; i < ls.size(); ++i) {
+            ls[i]->trace = nullptr;
+            ls[i]->quantize(samples[i]);
+        }
+        play(obs, p8, v8, acts);
+
+        report = quant_report();
+        report.steps = obs.size();
+        for (int t = 0; t < report.steps; ++t) {
+            const float *a = &p32[t * actions], *b = &p8[t * actions];
+            report.agreement += std::max_element(b, b + actions) - b == acts[t];
+            for (int j = 0; j < actions; ++j)
+                report.kl += a[j] * std::log(a[j] / b[j]);
+            report.value_err = std::max(report.value_err, (double)std::abs(v32[t] - v8[t]));
+        }
+        if (report.steps)
+            report.agreement /= report.steps, report.kl /= report.steps;
+        report.fp32_bytes = fp32.bytes(), report.int8_bytes = bytes();
+        if (report.agreement < min_agreement) {
+            *this = fp32;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    mutable std::vector<float> vec[8];
+    mutable std::vector<int> nz;
+
+    // cnn = the product of the 3x3, stride 2 convolutions, as the input weights of each feature. it
+    // runs backwards from a one-hot feature: a map of so x so positions with c_out channels (HWC)
+    // goes through the transposed layer as so * so rows, and each row's 3x3 x c_in patch is added
+    // back where the convolution read it from
+    bool fold(const weight_source& get) {
+        int H = hidden, L = 0;
+        std::vector<int> sides{side};
+        while (get("backbone.cnn.conv" + std::to_string(L) + ".weight"))
+            sides.push_back((sides[L++] - 3) / 2 + 1);
+        if (!L || sides[L] != 1)
+            return false;
+        std::vector<packed_dense> back(L);
+        for (int l = 0; l < L; ++l) {
+            const float* w = get("backbone.cnn.conv" + std::to_string(l) + ".weight");
+            int c = l ? H : channels;
+            // libtorch keeps [out][in][3][3]; the transposed layer maps out to (ky, kx, in)
+            std::vector<float> t((size_t)9 * c * H);
+            for (int o = 0; o < H; ++o)
+                for (int j = 0; j < c; ++j)
+                    for (int k = 0; k < 9; ++k)
+                        t[((size_t)k * c + j) * H + o] = w[((size_t)o * c + j) * 9 + k];
+            back[l].pack(t.data(), nullptr, 9 * c, H);
+        }
+        cnn.in = channels * side * side, cnn.out = H, cnn.ld = (H + 7) / 8 * 8;
+        cnn.w.assign((size_t)cnn.in * cnn.ld, 0);
+        cnn.b.assign(cnn.ld, 0);
+        std::vector<float> cur, nxt, patches;
+        std::vector<int> idx;
+        for (int o = 0; o < H; ++o) {
+            cur.assign(H, 0);
+            cur[o] = 1;
+            for (int l = L - 1; l >= 0; --l) {
+                int s = sides[l], so = sides[l + 1], c = l ? H : channels, ld = back[l].ld;
+                patches.resize((size_t)so * so * ld);
+                back[l].apply(cur.data(), so * so, H, patches.data(), ld, idx);
+                nxt.assign((size_t)s * s * c, 0);
+                for (int oy = 0; oy < so; ++oy)
+                    for (int ox = 0; ox < so; ++ox) {
+                        const float* q = &patches[(size_t)(oy * so + ox) * ld];
+                        for (int ky = 0; ky < 3; ++ky)
+                            for (int kx = 0; kx < 3; ++kx, q += c) {
+                                float* r = &nxt[((size_t)(2 * oy + ky) * s + 2 * ox + kx) * c];
+                                for (int j = 0; j < c; ++j)
+                                    r[j] += q[j];
+                            }
+                    }
+                cur.swap(nxt);
+            }
+            for (int i = 0; i < side * side; ++i)
+                for (int j = 0; j < channels; ++j)
+                    cnn.w[((size_t)j * side * side + i) * cnn.ld + o] = cur[(size_t)i * channels + j];
+        }
+        return true;
+    }
+
+    bool load_head(const std::string& name, int out, std::vector<packed_dense>& res, packed_dense& last, const weight_source& get) {
+        for (int i = 0; get(name + ".0.lin" + std::to_string(i) + ".weight"); ++i) {
+            const float* b = get(name + ".0.lin" + std::to_string(i) + ".bias");
+            if (!b)
+                return false;
+            res.emplace_back();
+            res.back().pack(get(name + ".0.lin" + std::to_string(i) + ".weight"), b, hidden, hidden);
+        }
+        const float *w = get(name + ".1.weight"), *b = get(name + ".1.bias");
+        if (!w || !b)
+            return false;
+        last.pack(w, b, out, hidden);
+        return true;
+    }
+
+    // x = x * n / (|x|_1 + 1e-8), the rescale the model applies after every block
+    static void rescale(float* x, int size, int n) {
+        double s = 0;
+        for (int i = 0; i < size; ++i)
+            s += std::abs(x[i]);
+        float d = (float)s + 1e-8f;
+        for (int i = 0; i < size; ++i)
+            x[i] = x[i] * n / d;
+    }
+
+    // one step of torch::nn::GRU over k rows of x and h: gates r, z, n in that order, h updated in place
+    void gru(int i, int k, const float* x, float* h) const {
+        int H = hidden, R = row;
+        float *gi = vec[5].data(), *gh = vec[6].data();
+        gru_ih[i].apply(x, k, R, gi, R, nz);
+        gru_hh[i].apply(h, k, R, gh, R, nz);
+        for (int t = 0; t < k; ++t) {
+            const float *a = gi + t * R, *b = gh + t * R;
+            float* ht = h + t * R;
+            for (int j = 0; j < H; ++j) {
+                float r = 1 / (1 + std::exp(-(a[j] + b[j])));
+                float z = 1 / (1 + std::exp(-(a[H + j] + b[H + j])));
+                float n = std::tanh(a[2 * H + j] + r * b[2 * H + j]);
+                ht[j] = (1 - z) * n + z * ht[j];
+            }
+        }
+    }
+
+    // ResB followed by the head's Linear, from k rows of x into y + r * ys
+    void head(const std::vector<packed_dense>& res, const packed_dense& last, int k, const float* x, float* y, int ys) const {
+        int H = hidden, R = row;
+        float *cur = vec[5].data(), *nxt = vec[6].data();
+        for (int r = 0; r < k; ++r) {
+            memcpy(cur + r * R, x + r * R, H * sizeof(float));
+            rescale(cur + r * R, H, H);
+        }
+        for (auto &l: res) {
+            l.apply(cur, k, R, nxt, R, nz);
+            for (int r = 0; r < k; ++r) {
+                float *c = cur + r * R, *t = nxt + r * R;
+                for (int j = 0; j < H; ++j)
+                    t[j] = std::max(t[j], 0.0f) + c[j];
+                rescale(t, H, H);
+            }
+            std::swap(cur, nxt);
+        }
+        float* o = vec[7].data();
+        last.apply(cur, k, R, o, R, nz);
+        for (int r = 0; r < k; ++r)
+            memcpy(y + r * ys, o + r * R, last.out * sizeof(float));
+    }
+};
@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+
+// the flat weight file of a policy: a header, count entries, then the float32 data of every entry
+// at a 64-byte aligned offset, all little-endian. nothing needs parsing, so a reader loads the file
+// and reads the floats where they lie. version goes up whenever the layout changes
+const uint32_t policy_file_version = 1;
+
+struct policy_file_header {
+    char magic[8];
+    uint32_t version, count;
+    int32_t channels, side, hidden, actions;
+};
+
+struct policy_file_entry {
+    // the libtorch parameter name, 0-terminated
+    char name[48];
+    // from the start of the file, in bytes, and in floats
+    uint64_t offset, size;
+};
+
+// one parameter to write, row-major as libtorch keeps it
+struct policy_tensor {
+    std::string name;
+    const float* data;
+    size_t size;
+};
+
+// writes tensors into path as a policy file; false if a name doesn't fit or the file can't be written
+inline bool write_policy_file(const std::string& path, int channels, int side, int hidden, int actions, const std::vector<policy_tensor>& tensors) {
+    policy_file_header header{{'S', 'F', 'P', 'O', 'L', 'I', 'C', 'Y'}, policy_file_version, (uint32_t)tensors.size(), channels, side, hidden, actions};
+    std::vector<policy_file_entry> entries(tensors.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(policy_file_entry);
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        if (tensors[i].name.size() >= sizeof(entries[i].name))
+            return false;
+        memset(entries[i].name, 0, sizeof(entries[i].name));
+        memcpy(entries[i].name, tensors[i].name.data(), tensors[i].name.size());
+        entries[i].offset = offset = (offset + 63) / 64 * 64;
+        entries[i].size = tensors[i].size;
+        offset += tensors[i].size * sizeof(float);
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)entries.data(), entries.size() * sizeof(policy_file_entry));
+    uint64_t at = sizeof(header) + entries.size() * sizeof(policy_file_entry);
+    const char pad[64] = {};
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        out.write(pad, entries[i].offset - at);
+        out.write((const char*)tensors[i].data, tensors[i].size * sizeof(float));
+        at = entries[i].offset + tensors[i].size * sizeof(float);
+    }
+    return (bool)out;
+}
+
+// a policy file read into memory; the floats stay valid until close(). policy_engine packs what
+// it reads into layers of its own, so one plain read serves better than a mapping kept open
+class policy_file {
+public:
+    policy_file() = default;
+    policy_file(const policy_file&) = delete;
+    policy_file& operator=(const policy_file&) = delete;
+
+    // reads path; false if it can't, or if it isn't a policy file of this version
+    bool open(const std::string& path) {
+        close();
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        std::streamoff length = in ? (std::streamoff)in.tellg() : -1;
+        if (length <= 0)
+            return false;
+        buffer.resize((length + sizeof(float) - 1) / sizeof(float));
+        in.seekg(0);
+        if (in.read((char*)buffer.data(), length))
+            data = (const char*)buffer.data(), size = length;
+        if (!data || !valid()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        std::vector<float>().swap(buffer);
+        data = nullptr, size = 0;
+    }
+
+    const policy_file_header& header() const {
+        return *(const policy_file_header*)data;
+    }
+
+    // the floats of the parameter called name, or nullptr
+    const float* find(const std::string& name) const {
+        const policy_file_entry* e = entries();
+        for (uint32_t i = 0; i < header().count; ++i)
+            if (name == e[i].name)
+                return (const float*)(data + e[i].offset);
+        return nullptr;
+    }
+
+private:
+    // the file's bytes, as floats so the data of every entry is aligned for them
+    std::vector<float> buffer;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    const policy_file_entry* entries() const {
+        return (const policy_file_entry*)(data + sizeof(policy_file_header));
+    }
+
+    // the magic and version match and every entry lies inside the file
+    bool valid() const {
+        if (size < sizeof(policy_file_header) || memcmp(header().magic, "SFPOLICY", 8) || header().version != policy_file_version)
+            return false;
+        if (size < sizeof(policy_file_header) + (uint64_t)header().count * sizeof(policy_file_entry))
+            return false;
+        for (uint32_t i = 0; i < header().count; ++i) {
+            const policy_file_entry& e = entries()[i];
+            if (e.name[sizeof(e.name) - 1] || e.offset % 64 || e.offset > size || e.size > (size - e.offset) / sizeof(float))
+                return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2025 bistoyek21 R.I.C.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// an observation keeping only its non-zero features, for rollouts and calibration sets.
+// pos[i] is the index of value[i] in the dense CHW observation (channel * cells + cell), so
+// observations of up to 65536 features fit; six bytes per feature instead of four per cell
+struct sparse_obs {
+    std::vector<uint16_t> pos;
+    std::vector<float> value;
+
+    // whether every observation of schema S can be stored
+    template<typename S>
+    static bool constexpr fits = S::size <= 65536;
+
+    sparse_obs() = default;
+
+    sparse_obs(const float* dense, int size) {
+        assign(dense, size);
+    }
+
+    void assign(const float* dense, int size) {
+        pos.clear(), value.clear();
+        for (int i = 0; i < size; ++i)
+            if (dense[i] != 0) {
+                pos.push_back(i);
+                value.push_back(dense[i]);
+            }
+    }
+
+    // writes the dense observation to out, which holds size floats; features past size are dropped
+    void densify(float* out, int size) const {
+        std::memset(out, 0, size * sizeof(float));
+        for (size_t i = 0; i < pos.size(); ++i)
+            if (pos[i] < size)
+                out[pos[i]] = value[i];
+    }
+
+    size_t bytes() const {
+        return pos.size() * (sizeof(uint16_t) + sizeof(float));
+    }
+};
@@ -34,7 +34,9 @@ namespace Environment::Field{
 		return Environment::Random::_rand();
 	}
 
-	int constexpr F = 3, N = 30, M = 100, H = 9000, Z = 9000, B = 9000, C = 9000, lim_portal = 1000, lim_block = 1100;
+	int F, N, M;
+
+	int constexpr H = 9000, B = 9000, C = 9000, lim_portal = 1000, lim_block = 1100;
 
 	int ind;
 
@@ -44,16 +46,257 @@ namespace Environment::Field{
 
 	const std::string valid_commands = "+qe3uzxawsdfghjkl;'cvbnm,./[]";
 
-	Environment::Item::Bullet bull[B];
-	Environment::Character::Zombie zomb[Z];
-	Environment::Character::Human hum[H];
+	enum command_kind{NOTHING, DIE, TURN, MOVE, BUILD, SELECT, USE, SHOT};
+
+	// what obey() does with a command character. phase 0 commands only change the player,
+	// phase 1 ones move it or change the map and phase 2 ones fire bullets
+	struct command_info{
+		char kind = NOTHING, arg = 0, phase = 0;
+		bool valid = false;
+	};
+
+	std::vector<command_info> make_commands(){
+		std::vector<command_info> res(256);
+		auto set = [&](char c, char kind, char arg, char phase){
+			res[(unsigned char)c] = {kind, arg, phase, false};
+			return;
+		};
+		set('_', DIE, 0, 0);
+		set('q', TURN, 0, 0), set('e', TURN, 1, 0);
+		std::string moves = "sdwa", cons = "fghj", throws = "kl;'", weapons = "cvbnm,./";
+		for(int i = 0; i < 4; ++i)
+			set(moves[i], MOVE, i, 1), set(cons[i], SELECT, i, 0), set(throws[i], SELECT, 8 + i, 0);
+		for(int i = 0; i < 8; ++i)
+			set(weapons[i], SELECT, 16 + i, 0);
+		set('[', BUILD, 0, 1), set(']', BUILD, 1, 1);
+		set('u', USE, 0, 0);
+		set('z', SHOT, 0, 2), set('x', SHOT, 1, 2);
+		for(const char &e: valid_commands)
+			res[(unsigned char)e].valid = true;
+		return res;
+	}
+
+	const std::vector<command_info> commands = make_commands();
+
+	// slots are allocated in blocks of S objects the first time they are touched and never move,
+	// so the map can keep pointers to them. capacity() is the number of slots a match may use.
+	// for characters the combat state of a block is kept in a packed array next to the objects.
+	// every slot keeps its own index, so a pointer taken from the map gives its index in O(1)
+	template<typename T, int S = 64>
+	class pool{
+		static bool constexpr packed = std::is_base_of_v<Environment::Character::Character, T>;
+
+		struct slot: T{
+			int id = -1;
+		};
+
+		std::vector<std::unique_ptr<slot[]>> blocks;
+		std::vector<std::unique_ptr<Environment::Character::combat_state[]>> hot;
+		int cap;
+
+	public:
+		explicit pool(int cap): cap(cap){}
+
+		T& operator[](int i){
+			while((int)blocks.size() <= i / S){
+				blocks.push_back(std::make_unique<slot[]>(S));
+				for(int j = 0; j < S; ++j)
+					blocks.back()[j].id = ((int)blocks.size() - 1) * S + j;
+				if constexpr(packed){
+					hot.push_back(std::make_unique<Environment::Character::combat_state[]>(S));
+					for(int j = 0; j < S; ++j)
+						blocks.back()[j].bind(&hot.back()[j]);
+				}
+			}
+			return blocks[i / S][i % S];
+		}
+
+		const T& operator[](int i) const{
+			return blocks[i / S][i % S];
+		}
+
+		const Environment::Character::combat_state& state(int i) const{
+			return hot[i / S][i % S];
+		}
+
+		// p must point into this pool
+		int index_of(const T* p) const{
+			return static_cast<const slot*>(p)->id;
+		}
+
+		// whether character p is one of this pool's slots, without touching p's memory past it
+		// unless p says it is pooled
+		bool contains(const T* p) const{
+			static_assert(packed);
+			return p->pooled() && index_of(p) < allocated() && &(*this)[index_of(p)] == p;
+		}
+
+		int capacity() const{
+			return cap;
+		}
+
+		void set_capacity(int c){
+			cap = c;
+			return;
+		}
+
+		int allocated() const{
+			return blocks.size() * S;
+		}
+
+		long long footprint() const{
+			return (long long)allocated() * (sizeof(slot) + packed * sizeof(Environment::Character::combat_state));
+		}
+	};
+
+	// the live slots of a pool in no particular order, with O(1) lookup and erase. a new object
+	// takes the lowest free slot, found in O(log n) instead of scanning every slot
+	class live_set{
+		std::vector<int> list, at;
+		std::priority_queue<int, std::vector<int>, std::greater<int>> freed;
+		int top = 0;
+
+	public:
+		bool operator[](int i) const{
+			return i < (int)at.size() && at[i] != -1;
+		}
+
+		int count() const{
+			return list.size();
+		}
+
+		// the slot insert() will take
+		int next() const{
+			return freed.empty() ? top : freed.top();
+		}
+
+		int insert(){
+			int i = next();
+			if(freed.empty())
+				++top;
+			else
+				freed.pop();
+			if((int)at.size() <= i)
+				at.resize(i + 1, -1);
+			at[i] = list.size();
+			list.push_back(i);
+			return i;
+		}
+
+		void erase(int i){
+			int j = list.back();
+			list[at[i]] = j, at[j] = at[i];
+			list.pop_back();
+			at[i] = -1;
+			freed.push(i);
+			return;
+		}
+
+		void reset(){
+			list.clear(), at.clear();
+			freed = {};
+			top = 0;
+			return;
+		}
 
-	std::vector<int> portal[B];
+		const std::vector<int>& slots() const{
+			return list;
+		}
+	};
+
+	// number of slots a match of each mode may use, pools only allocate the slots that are reached
+	struct capacity{
+		std::string mode;
+		int h, z, b;
+	};
+
+	const capacity mode_capacity[] = {{"Solo", 1000, 4000, 4000}, {"Timer", 1000, 4000, 4000}, {"Squad", 10, 4000, 4000},
+		{"Battle Royal", H, 9000, B}, {"AI Battle Royal", H, 9000, B}};
 
-	std::bitset<B> mb, active;
-	std::bitset<Z> mz;
+	// on maps bigger than the stock one the zombie slots and spawns grow with the floor area: one
+	// slot per zombie_cells cells and one spawn attempt per zombie_spawn_cells cells
+	int constexpr zombie_cells = 100, zombie_spawn_cells = 9000;
+
+	pool<Environment::Item::Bullet> bull(B);
+	pool<Environment::Character::Zombie> zomb(9000);
+	pool<Environment::Character::Human> hum(H);
+
+	// the portals of the map and of the players, active[i] while portal i stands
+	std::vector<std::vector<int>> portal;
+	std::vector<char> active;
+
+	std::bitset<B> mb;
+	live_set mz;
 	std::bitset<H> mh, remote;
 
+	// the world is split into CS x CS chunks per floor, a chunk is allocated when the first zombie enters it.
+	// lod 0: next to a human (full rate), 1: reduced rate, 2: frozen
+	int constexpr CS = 32, lod_period = 4, lod_catch_up = 64;
+
+	int CN, CM, zombie_spawns = 1;
+
+	// counts the matches set up so far, caches built from one match's map check it before reuse
+	long long match_epoch = 0;
+
+	// an NPC thinks every tick near the player, every 2 ticks farther than think_near cells
+	// and every 4 ticks on another floor, twice as rarely while idle. at most think_limit humans,
+	// agents included, decide in one tick and the NPCs left wait for the next tick. the limit is a
+	// count rather than a time so a match plays the same on every machine. agents decide every
+	// tick so their rollouts have one step per tick
+	int constexpr think_near = 16, think_limit = 64;
+
+#if defined(CHUNKED_LOD)
+	struct chunk{
+		std::vector<int> zombies;
+		// position in live_chunks, -1 while the chunk has no zombie
+		int at = -1;
+
+		void erase(int z){
+			for(int i = 0; i < (int)zombies.size(); ++i)
+				if(zombies[i] == z){
+					std::swap(zombies[i], zombies.back());
+					zombies.pop_back();
+					return;
+				}
+			return;
+		}
+	};
+
+	std::vector<std::unique_ptr<chunk>> chunks;
+	// the chunks that hold zombies, the only ones zombie_action() looks at
+	std::vector<int> live_chunks;
+	std::vector<char> lod;
+	std::vector<long long> zlast;
+#endif
+
+	int chunk_id(int f, int i, int j){
+		return (f * CN + i / CS) * CM + j / CS;
+	}
+
+#if defined(CHUNKED_LOD)
+	void chunk_add(int id, int z){
+		if(!chunks[id])
+			chunks[id] = std::make_unique<chunk>();
+		chunk &c = *chunks[id];
+		if(c.zombies.empty())
+			c.at = live_chunks.size(), live_chunks.push_back(id);
+		c.zombies.push_back(z);
+		return;
+	}
+
+	void chunk_remove(int id, int z){
+		chunk &c = *chunks[id];
+		c.erase(z);
+		if(c.zombies.empty()){
+			int last = live_chunks.back();
+			live_chunks[c.at] = last, chunks[last]->at = c.at;
+			live_chunks.pop_back();
+			c.at = -1;
+		}
+		return;
+	}
+#endif
+
 	class Client{
 
 	public:
@@ -206,29 +449,67 @@ namespace Environment::Field{
 		struct sockaddr_in server_addr;
 	} client;
 
+	// F x N x M cells stored contiguously, every floor has a ring of border cells around it
+	// so the neighbours of any cell of the map can be accessed without bounds checks
+	template<typename T>
+	class grid{
+
+		template<typename U>
+		struct layer{
+			U* p;
+			int stride;
+
+			U* operator[](int i) const{
+				return p + i * stride;
+			}
+		};
+
+		int f = 0, n = 0, m = 0;
+		std::vector<T> cells;
+
+	public:
+		void resize(int f, int n, int m, const T &border){
+			this->f = f, this->n = n, this->m = m;
+			cells.assign((long long)f * (n + 2) * (m + 2), border);
+			return;
+		}
+
+		layer<T> operator[](int k){
+			return {cells.data() + ((long long)k * (n + 2) + 1) * (m + 2) + 1, m + 2};
+		}
+
+		layer<const T> operator[](int k) const{
+			return {cells.data() + ((long long)k * (n + 2) + 1) * (m + 2) + 1, m + 2};
+		}
+
+		typename std::vector<T>::iterator begin(){
+			return cells.begin();
+		}
+
+		typename std::vector<T>::iterator end(){
+			return cells.end();
+		}
+	};
+
 	int p_ind(){
-		for(int i = 0; i < B; ++i)
+		for(int i = 0; i < (int)portal.size(); ++i)
 			if(!active[i])
 				return i;
-		return -1;
+		if((int)portal.size() == B)
+			return -1;
+		portal.emplace_back(), active.push_back(0);
+		return portal.size() - 1;
 	}
 
 	int h_ind(){
-		for(int i = 0; i < H; ++i)
+		for(int i = 0; i < hum.capacity(); ++i)
 			if(i != ind && !mh[i] && !remote[i])
 				return i;
 		return -1;
 	}
 
-	int z_ind(){
-		for(int i = 0; i < Z; ++i)
-			if(!mz[i])
-				return i;
-		return -1;
-	}
-
 	int b_ind(){
-		for(int i = 0; i < B; ++i)
+		for(int i = 0; i < bull.capacity(); ++i)
 			if(!mb[i])
 				return i;
 		return -1;
@@ -428,12 +709,21 @@ namespace Environment::Field{
 		}
 	} temp_cell;
 
-	temp_node temp_map[N][M];
+	std::vector<temp_node> temp_map;
 
 	Environment::Character::Human temp_me;
 
 	const node nd;
 
+	enum match_kind{SOLO, TIMER, SQUAD, ONLINE};
+
+	// everything the match loop branches on that is fixed once the match has started
+	template<int KIND, bool REPLAY, bool LOGGING, bool AGENT>
+	struct policy{
+		static int constexpr kind = KIND;
+		static bool constexpr online = (KIND == ONLINE), replay = REPLAY, logging = LOGGING, agent = AGENT;
+	};
+
 	struct gameplay{
 		bool enable_logging = false;
     	bool replay_mode = false;
@@ -454,12 +744,29 @@ namespace Environment::Field{
 
 		std::string temp_recZ, temp_recH;
 
-		std::string action, mode;
+		std::string action, mode, action_src;
+
+		int action_index[256] = {};
+
+		// live humans of the current tick in the randomized order, split by command phase
+		std::vector<int> order, phase[3];
+
+		std::vector<long long> think_next;
+		std::vector<char> last_command;
+		// humans whose agents decide this tick, run through bots() together
+		std::vector<int> deciding;
+		// NPCs left to the scheduler this tick, served from think_from on
+		std::vector<int> scheduled;
+		int think_from = 0;
 
 		const int L = 10, pc = 30, pz = 40, ph = 50, wdx[4] = {1, 0, -1, 0}, wdy[4] = {0, 1, 0, -1};
 
 		long long loot, level, teams_kills, kills, chest, frame, serial_number;
 
+		// live humans of every team, updated by the births and deaths that change them
+		std::vector<int> team_alive;
+		int humans_alive = 0;
+
 		long long loot1, teams_kills1, frame1;
 
 		bool is_training1;
@@ -468,14 +775,20 @@ namespace Environment::Field{
 
 		std::vector<node*> temp;
 
-		std::vector<int> place[2 * B];
+		std::vector<int> zorder;
+
+		std::vector<std::vector<int>> place;
 
 		time_t tb;
 
-		node themap[F][N][M], themap1[F][N][M];
+		grid<node> themap, themap1, pristine;
+		std::vector<std::vector<int>> pristine_portal;
 
 		char bot(Environment::Character::Human& player) const;
 
+		// commands of the agents of hum[idx[0]], hum[idx[1]], ... decided in one batch
+		std::string bots(const std::vector<int> &idx) const;
+
 		char human_rnpc_bot(Environment::Character::Human& player) const;
 
 		void prepare(Environment::Character::Human& player);
@@ -487,21 +800,38 @@ namespace Environment::Field{
 		void load_data();
 
 		void updmap(){
-			for(int i = 0; i < F; ++i)
-                for(int j = 0; j < N; ++j)
-                    for(int k = 0; k < M; ++k)
-                        themap[i][j][k].update();
-            return;
-        }
+			for(auto &e: themap)
+				e.update();
+			return;
+		}
+
+		void human_born(int i){
+			int team = hum.state(i).team;
+			if((int)team_alive.size() <= team)
+				team_alive.resize(team + 1);
+			++team_alive[team], ++humans_alive;
+			return;
+		}
+
+		void human_died(int i){
+			--team_alive[hum.state(i).team], --humans_alive;
+			return;
+		}
+
+		void count_alive(){
+			team_alive.assign(1, 0);
+			humans_alive = 0;
+			for(int i = 0; i < hum.capacity(); ++i)
+				if(mh[i])
+					human_born(i);
+			return;
+		}
 
 		bool rivals_are_dead(){
-			for(int i = 0; i < H; ++i)
-				if(mh[i]){
-					int team = hum[i].get_team();
-					if(team && team != hum[ind].get_team())
-						return false;
-                }
-			return true;
+			int team = hum.state(ind).team, rivals = humans_alive - team_alive[0];
+			if(team)
+				rivals -= team_alive[team];
+			return !rivals;
         }
 
 		void claim_chest(Environment::Character::Human& player){
@@ -542,17 +872,20 @@ namespace Environment::Field{
 		}
 
 		void spawn_zombie_npc(){
-			int i = rand() % F, j = rand() % N, k = rand() % M;
-			if(themap[i][j][k].showit() != '.')
-				return;
-			int index = z_ind();
-			if(index == -1)
-				return;
-			bool super = (rand() % 4 == 0);
-			Environment::Character::gen_zombie(zomb[index], super, std::vector<int>{i, j, k}, (super ? "SZ" : "Z") + std::to_string(frame));
-			themap[i][j][k].zombie = &zomb[index];
-			themap[i][j][k].s[1] = 1;
-			mz[index] = true;
+			for(int t = 0; t < zombie_spawns; ++t){
+				int i = rand() % F, j = rand() % N, k = rand() % M;
+				if(themap[i][j][k].showit() != '.' || zomb.capacity() <= mz.next())
+					continue;
+				int index = mz.insert();
+				bool super = (rand() % 4 == 0);
+				Environment::Character::gen_zombie(zomb[index], super, std::vector<int>{i, j, k}, (super ? "SZ" : "Z") + std::to_string(frame));
+				themap[i][j][k].zombie = &zomb[index];
+				themap[i][j][k].s[1] = 1;
+#if defined(CHUNKED_LOD)
+				chunk_add(chunk_id(i, j, k), index);
+				zlast[index] = frame;
+#endif
+			}
 			return;
 		}
 
@@ -568,6 +901,7 @@ namespace Environment::Field{
 			themap[i][j][k].s[0] = 1;
 			remote[index] = false;
 			mh[index] = true;
+			human_born(index);
 			return;
 		}
 
@@ -580,9 +914,14 @@ namespace Environment::Field{
 				owner->set_damage(owner->get_damage() + pix->bullet->get_damage());
 				owner->set_effect(owner->get_effect() + pix->bullet->get_effect());
 			}
-			mb[pix->bullet - bull] = false;
+			mb[bull.index_of(pix->bullet)] = false;
 			if(pix->zombie->get_Hp() <= 0){
-				mz[pix->zombie - zomb] = false;
+				int z = zomb.index_of(pix->zombie);
+				mz.erase(z);
+#if defined(CHUNKED_LOD)
+				const int* v = zomb.state(z).cor;
+				chunk_remove(chunk_id(v[0], v[1], v[2]), z);
+#endif
 				pix->s[8] = 1;
 				pix->s[1] = 0;
 				if(owner && owner->get_team() == hum[ind].get_team()){
@@ -597,14 +936,15 @@ namespace Environment::Field{
 			return;
 		}
 
+		// backwards, since a zombie that dies is swapped with the last live one
 		void hit_zombie(){
-			for(int i = 0; i < Z; ++i)
-				if(mz[i]){
-					std::vector<int> v = zomb[i].get_cor();
-					auto pix = &themap[v[0]][v[1]][v[2]];
-					if(pix->s[2])
-						zombie_damage(pix);
-				}
+			const auto &live = mz.slots();
+			for(int k = (int)live.size() - 1; k >= 0; --k){
+				const int* v = zomb.state(live[k]).cor;
+				auto pix = &themap[v[0]][v[1]][v[2]];
+				if(pix->s[2])
+					zombie_damage(pix);
+			}
 			return;
 		}
 
@@ -617,9 +957,11 @@ namespace Environment::Field{
 				owner->set_damage(owner->get_damage() + pix->bullet->get_damage());
 				owner->set_effect(owner->get_effect() + pix->bullet->get_effect());
 			}
-			mb[pix->bullet - bull] = false;
+			mb[bull.index_of(pix->bullet)] = false;
 			if(pix->human->get_Hp() <= 0){
-				mh[pix->human - hum] = false;
+				int h = hum.index_of(pix->human);
+				if(mh[h])
+					mh[h] = false, human_died(h);
 				pix->s[8] = 1;
 				pix->s[0] = (&hum[ind] == pix->human);
 				if(owner && owner->get_team() == hum[ind].get_team() && pix->human->get_team() != hum[ind].get_team()){
@@ -634,78 +976,131 @@ namespace Environment::Field{
 		}
 
 		void hit_human(){
-			for(int i = 0; i < H; ++i)
+			for(int i = 0; i < hum.capacity(); ++i)
 		        if(mh[i]){
-	        		std::vector<int> v = hum[i].get_cor();
+	        		const int* v = hum.state(i).cor;
 	       			auto pix = &themap[v[0]][v[1]][v[2]];
-					if(hum[i].get_Hp() <= 0){
+					if(hum.state(i).Hp <= 0){
 						mh[i] = false;
+						human_died(i);
 						pix->s[8] = 1;
 						pix->s[0] = (pix->human == &hum[ind]);
 					}
 	       			else if(pix->s[2])
     	       			human_damage(pix);
-					if(hum[i].get_Hp() <= 0 && i != ind)
+					if(hum.state(i).Hp <= 0 && i != ind)
 						hum[i].deleteAgent();
 				}
         	return;
 		}
 
-		void zombie_action(){
-			node* pix;
-			for(int _ = 0; _ < Z; ++_)
-				if(mz[_]){
-					std::vector<int> v = zomb[_].get_cor();
-					int i = v[0], j = v[1], k = v[2];
-					if(themap[i][j][k].s[2])
-						continue;
-					bool b = false;
-					for(int i1 = 0; i1 < 4; ++i1){
-						if(themap[i][wdx[i1] + j][wdy[i1] + k].s[0]){
-							pix = &themap[i][wdx[i1] + j][wdy[i1] + k];
-							int index = b_ind();
-							std::vector<int> v = {i, j + wdx[i1], k + wdy[i1]};
-							if(!pix->s[2] && index != -1){
-								themap[i][j][k].zombie->punch(bull[index], i1);
-								pix->bullet = &bull[index];
-								pix->s[2] = 1;
-								mb[index] = true;
-							}
-							b = true;
-						}
-					}
-					if(b == false){
-						if(rand() % 5 < 2)
-							continue;
-						for(int i1 = 0; i1 < 2; ++i1){
-							int i2 = rand() % 4;
-							if(themap[i][wdx[i2] + j][wdy[i2] + k].showit() == '.'){
-								themap[i][wdx[i2] + j][wdy[i2] + k].s[1] = 1;
-								themap[i][wdx[i2] + j][wdy[i2] + k].zombie = &zomb[_];
-								themap[i][j][k].s[1] = 0;
-								zomb[_].set_cor(std::vector<int>{i, wdx[i2] + j, wdy[i2] + k});
-								break;
-							}
+#if defined(CHUNKED_LOD)
+		void update_lod(){
+			std::fill(lod.begin(), lod.end(), 2);
+			for(int _ = 0; _ < hum.capacity(); ++_)
+				if(mh[_]){
+					std::vector<int> v = hum[_].get_cor();
+					int ci = v[1] / CS, cj = v[2] / CS;
+					for(int i = std::max(ci - 2, 0); i <= std::min(ci + 2, CN - 1); ++i)
+						for(int j = std::max(cj - 2, 0); j <= std::min(cj + 2, CM - 1); ++j){
+							int id = (v[0] * CN + i) * CM + j;
+							lod[id] = std::min<int>(lod[id], std::max(abs(i - ci), abs(j - cj)) > 1);
 						}
+				}
+			return;
+		}
+#endif
+
+		void zombie_wander(int _){
+			std::vector<int> v = zomb[_].get_cor();
+			int i = v[0], j = v[1], k = v[2];
+			if(rand() % 5 < 2)
+				return;
+			for(int i1 = 0; i1 < 2; ++i1){
+				int i2 = rand() % 4;
+				if(themap[i][wdx[i2] + j][wdy[i2] + k].showit() == '.'){
+					themap[i][wdx[i2] + j][wdy[i2] + k].s[1] = 1;
+					themap[i][wdx[i2] + j][wdy[i2] + k].zombie = &zomb[_];
+					themap[i][j][k].s[1] = 0;
+					zomb[_].set_cor(std::vector<int>{i, wdx[i2] + j, wdy[i2] + k});
+#if defined(CHUNKED_LOD)
+					int c0 = chunk_id(i, j, k), c1 = chunk_id(i, wdx[i2] + j, wdy[i2] + k);
+					if(c0 != c1)
+						chunk_remove(c0, _), chunk_add(c1, _);
+#endif
+					return;
+				}
+			}
+			return;
+		}
+
+		void zombie_step(int _){
+			node* pix;
+			std::vector<int> v = zomb[_].get_cor();
+			int i = v[0], j = v[1], k = v[2];
+			if(themap[i][j][k].s[2])
+				return;
+			bool b = false;
+			for(int i1 = 0; i1 < 4; ++i1){
+				if(themap[i][wdx[i1] + j][wdy[i1] + k].s[0]){
+					pix = &themap[i][wdx[i1] + j][wdy[i1] + k];
+					int index = b_ind();
+					if(!pix->s[2] && index != -1){
+						themap[i][j][k].zombie->punch(bull[index], i1);
+						pix->bullet = &bull[index];
+						pix->s[2] = 1;
+						mb[index] = true;
 					}
+					b = true;
+				}
+			}
+			if(b == false)
+				zombie_wander(_);
+			return;
+		}
+
+		// zombies act in slot order, so a match plays the same whichever order they were listed in
+		void zombie_action(){
+#if defined(CHUNKED_LOD)
+			update_lod();
+			zorder.clear();
+			bool reduced = (frame / 2) % lod_period == 0;
+			for(int c: live_chunks)
+				if(lod[c] == 0 || (lod[c] == 1 && reduced))
+					zorder.insert(zorder.end(), chunks[c]->zombies.begin(), chunks[c]->zombies.end());
+			std::sort(zorder.begin(), zorder.end());
+			for(int _: zorder){
+				std::vector<int> v = zomb[_].get_cor();
+				if(!lod[chunk_id(v[0], v[1], v[2])]){
+					long long missed = std::min<long long>((frame - zlast[_]) / 2 - 1, lod_catch_up);
+					for(int t = 0; t < missed; ++t)
+						zombie_wander(_);
 				}
+				zlast[_] = frame;
+				zombie_step(_);
+			}
+#else
+			zorder = mz.slots();
+			std::sort(zorder.begin(), zorder.end());
+			for(int _: zorder)
+				zombie_step(_);
+#endif
 			return;
 		}
 
 		void obey(const char c, Environment::Character::Human &player){
-		    if(c == '_'){
-                player.set_Hp(0);
-                return;
-		    }
-		    if(c == '[' || c == ']'){
+			const command_info &cmd = commands[(unsigned char)c];
+			switch(cmd.kind){
+			case DIE:
+				player.set_Hp(0);
+				return;
+			case BUILD:{
                 std::vector<int> v = player.get_cor();
                 int d = player.get_way() - 1;
 				v[1] += wdx[d], v[2] += wdy[d];
-				if(v[1] >= N || 0 > v[1] || v[2] >= M || 0 > v[2])
-					return;
                 if(themap[v[0]][v[1]][v[2]].showit() != '.')
                     return;
-                if(c == '['){
+                if(cmd.arg == 0){
                     if(player.backpack.get_blocks()){
                         themap[v[0]][v[1]][v[2]].s[10] = themap[v[0]][v[1]][v[2]].s[3] = 1;
                         player.backpack.use_block();
@@ -713,40 +1108,31 @@ namespace Environment::Field{
                     }
                     return;
                 }
-                else{
-                    if(~player.backpack.get_portal_ind()){
-                    	themap[v[0]][v[1]][v[2]].s[10] = themap[v[0]][v[1]][v[2]].s[5] = 1;
-                        themap[v[0]][v[1]][v[2]].portal_ind = player.backpack.get_portal_ind();
-                        player.backpack.set_portal_ind(-1);
-                        temp.push_back(&themap[v[0]][v[1]][v[2]]);
-                    }
-                    else if(player.backpack.get_portals()){
-                    	int index = p_ind();
-                    	if(index == -1)
-                    		return;
-                    	themap[v[0]][v[1]][v[2]].s[10] = themap[v[0]][v[1]][v[2]].s[7] = 1;
-                    	player.backpack.use_portal();
-                    	player.backpack.set_portal_ind(index);
-                    	portal[index] = v;
-                    	active[index] = 1;
-                    	temp.push_back(&themap[v[0]][v[1]][v[2]]);
-                    }
-                    return;
+                if(~player.backpack.get_portal_ind()){
+                	themap[v[0]][v[1]][v[2]].s[10] = themap[v[0]][v[1]][v[2]].s[5] = 1;
+                    themap[v[0]][v[1]][v[2]].portal_ind = player.backpack.get_portal_ind();
+                    player.backpack.set_portal_ind(-1);
+                    temp.push_back(&themap[v[0]][v[1]][v[2]]);
+                }
+                else if(player.backpack.get_portals()){
+                	int index = p_ind();
+                	if(index == -1)
+                		return;
+                	themap[v[0]][v[1]][v[2]].s[10] = themap[v[0]][v[1]][v[2]].s[7] = 1;
+                	player.backpack.use_portal();
+                	player.backpack.set_portal_ind(index);
+                	portal[index] = v;
+                	active[index] = 1;
+                	temp.push_back(&themap[v[0]][v[1]][v[2]]);
                 }
                 return;
-		    }
-			if(c == 'q' || c == 'e'){
-				(c == 'e' ? player.turn_r() : player.turn_l());
-				return;
 			}
-			if(c == 'a' || c == 's' || c == 'd' || c == 'w'){
-				int i = 0;
-				char s[4] = {'s', 'd', 'w', 'a'};
-				while(c != s[i])
-					++i;
+			case TURN:
+				(cmd.arg ? player.turn_r() : player.turn_l());
+				return;
+			case MOVE:{
+				int i = cmd.arg;
 				std::vector<int> v = player.get_cor();
-				if(v[1] + wdx[i] >= N || 0 > v[1] + wdx[i] || v[2] + wdy[i] >= M || 0 > v[2] + wdy[i])
-					return;
 				char sit = themap[v[0]][v[1] + wdx[i]][v[2] + wdy[i]].showit();
 				if(sit == '?' || sit == '^' || sit == 'v' || sit == '.' || sit == 'X' || sit == '*'){
 					themap[v[0]][v[1] + wdx[i]][v[2] + wdy[i]].s[0] = 1;
@@ -756,52 +1142,30 @@ namespace Environment::Field{
 				}
 				return;
 			}
-			if(c == 'f' || c == 'g' || c == 'h' || c == 'j'){
-				int i = 0;
-				char s[4] = {'f', 'g', 'h', 'j'};
-				while(c != s[i])
-					++i;
-				if(!player.backpack.list_cons[i].second)
+			case SELECT:{
+				int vec = cmd.arg / 8, i = cmd.arg % 8;
+				if(vec == 0 && !player.backpack.list_cons[i].second)
 					return;
-				player.backpack.vec = 0;
-				player.backpack.ind = i;
-				return;
-			}
-			if(c == 'k' || c == 'l' || c == ';' || c == '\''){
-				int i = 0;
-				char s[4] = {'k', 'l', ';', '\''};
-				while(c != s[i])
-					++i;
-				if(!player.backpack.list_throw[i].second.second)
+				if(vec == 1 && !player.backpack.list_throw[i].second.second)
 					return;
-				player.backpack.vec = 1;
-				player.backpack.ind = i;
-				return;
-			}
-			if(c == 'c' || c == 'v' || c == 'b' || c == 'n' || c == 'm' || c == ',' || c == '.' || c == '/'){
-				int i = 0;
-				char s[8] = {'c', 'v', 'b', 'n', 'm', ',', '.', '/'};
-				while(c != s[i])
-					++i;
-				if(!player.backpack.list_w[i].second)
+				if(vec == 2 && !player.backpack.list_w[i].second)
 					return;
-				player.backpack.vec = 2;
+				player.backpack.vec = vec;
 				player.backpack.ind = i;
 				return;
 			}
-			if(c == 'u'){
+			case USE:
 				player.use(player.backpack.list_cons[player.backpack.ind].first);
 				return;
-			}
-			if(c == 'z' || c == 'x'){
+			case SHOT:{
 				int bway = player.get_way() - 1;
 				std::vector<int> v = player.get_cor();
 				v[1] += wdx[bway], v[2] += wdy[bway];
 				int index = b_ind();
-				if(index == -1 || v[1] >= N || 0 > v[1] || v[2] >= M || 0 > v[2])
+				if(index == -1)
 					return;
 				bool can;
-				if(c == 'z')
+				if(cmd.arg == 0)
 					can = player.punch(bull[index]);
 				else if(player.backpack.vec == 1)
 					can = player.throw_it(bull[index]);
@@ -817,6 +1181,7 @@ namespace Environment::Field{
 				}
 				return;
 			}
+			}
 			return;
 		}
 	
@@ -919,28 +1284,28 @@ namespace Environment::Field{
 				command[ind] = '+';
 				return;
 			}
-			for(const char &e: valid_commands)
-				if(e == command[ind])
-					return;
-			command[ind] = '+';
+			if(!commands[(unsigned char)command[ind]].valid)
+				command[ind] = '+';
 			return;
 		}
 
+		template<typename P>
 		void get_command(int i){
 			if(hum[i].is_rnpc())
 				command[i] = human_rnpc_bot(hum[i]);
-			else if(!replay_mode)
+			else if constexpr(!P::replay)
 				command[i] = bot(hum[i]);
 			else
 				command[i] = '+';
 			return;
 		}
 
+		template<typename P>
 		void get_my_action(){
 			my_command();
 			if(quit){
 				command[ind] = '_';
-				if(online && !replay_mode){
+				if constexpr(P::online && !P::replay){
 					client.send_it();
 					client.end_it();
 				}
@@ -952,65 +1317,147 @@ namespace Environment::Field{
 				while(getch() != ' ');
 				return;
 			}
-			if(using_an_agent){
+			if constexpr(P::agent){
 				char c = bot(hum[ind]);
 				if(!manual && command[ind] != '3')
 					command[ind] = c;
 			}
-			if(online && !replay_mode)
+			if constexpr(P::online && !P::replay)
 				client.send_it();
 			return;
 		}
 
+		// whether NPC i is due to decide a new command this tick, otherwise it repeats last_command[i]
+		bool think(int i){
+			if(frame < think_next[i])
+				return false;
+			const auto &me_ = hum.state(ind), &e = hum.state(i);
+			int period = 1;
+			if(e.cor[0] != me_.cor[0])
+				period = 4;
+			else if(std::max(abs(e.cor[1] - me_.cor[1]), abs(e.cor[2] - me_.cor[2])) > think_near)
+				period = 2;
+			if(last_command[i] == '+')
+				period *= 2;
+			think_next[i] = frame + 2 * period;
+			return true;
+		}
+
+		// serves the scheduled NPCs in a rotating order until think_limit decisions were made this
+		// tick, the next tick starts with the first one that was cut
+		template<typename P>
+		void scheduled_action(){
+			int n = scheduled.size(), first = std::lower_bound(scheduled.begin(), scheduled.end(), think_from) - scheduled.begin();
+			int left = think_limit - (int)deciding.size();
+			bool cut = false;
+			for(int k = 0; k < n; ++k){
+				int i = scheduled[(first + k) % n];
+				if(!cut && left <= 0)
+					cut = true, think_from = i;
+				if(cut || !think(i)){
+					command[i] = last_command[i];
+					continue;
+				}
+				get_command<P>(i);
+				last_command[i] = command[i];
+				--left;
+			}
+			return;
+		}
+
+		template<typename P>
 		void human_action(){
-			if (enable_logging)
+			if constexpr(P::logging)
 				log_file << command[ind] << '\n';
-			if (replay_mode)
+			if constexpr(P::replay)
 				replay_file >> command[ind];
-			if(using_an_agent){
-				int act = 0;
-				for(int i = 0; i < action.size(); ++i)
-					if(action[i] == command[ind])
-						act = i;
-				hum[ind].agent->update(act, manual || command[ind] == '3');
-			}
-			if(online && !disconnect && !replay_mode)
-				client.recieve();
-			for(int i = 0; i < H; ++i)
+			if constexpr(P::agent){
+				hum[ind].agent->update(action_of(command[ind]), manual || command[ind] == '3');
+			}
+			if constexpr(P::online && !P::replay)
+				if(!disconnect)
+					client.recieve();
+			deciding.clear();
+			scheduled.clear();
+			for(int i = 0; i < hum.capacity(); ++i)
 				if(i != ind && mh[i]) {
 					if (remote[i]) {
-						if (enable_logging)
+						if constexpr(P::logging)
 							log_file << command[i] << '\n';
-						if (replay_mode)
+						if constexpr(P::replay)
 							replay_file >> command[i];
 					}
 					else {
-						get_command(i);
+						if constexpr(!P::logging && !P::replay)
+							if(hum[i].get_active_agent() && !hum[i].is_rnpc()){
+								deciding.push_back(i);
+								continue;
+							}
+						#if defined(DECISION_SCHEDULER)
+						if constexpr(!P::logging && !P::replay)
+							if(!hum[i].get_active_agent()){
+								scheduled.push_back(i);
+								continue;
+							}
+						#endif
+						get_command<P>(i);
+						last_command[i] = command[i];
 						if(hum[i].get_active_agent()){
-							if (enable_logging)
+							if constexpr(P::logging)
 								log_file << command[i] << '\n';
-							if (replay_mode)
+							if constexpr(P::replay)
 								replay_file >> command[i];
-							int act = 0;
-							for(int j = 0; j < action.size(); ++j)
-								if(action[j] == command[i])
-									act = j;
-							hum[i].agent->update(act, false);
+							hum[i].agent->update(action_of(command[i]), false);
 						}
 					}
 				}
-			int r = rand() & 1, st = (1 - r) * (H - 1), dif = 2 * r - 1;
-			for(int i = st; i < H && (~i); i += dif)
+			if(!deciding.empty()){
+				std::string c = bots(deciding);
+				for(int k = 0; k < (int)deciding.size(); ++k){
+					int i = deciding[k];
+					command[i] = last_command[i] = c[k];
+					hum[i].agent->update(action_of(command[i]), false);
+				}
+			}
+			#if defined(DECISION_SCHEDULER)
+			if constexpr(!P::logging && !P::replay)
+				scheduled_action<P>();
+			#endif
+			int r = rand() & 1, st = (1 - r) * (hum.capacity() - 1), dif = 2 * r - 1;
+			for(auto &e: phase)
+				e.clear();
+			order.clear();
+			for(int i = st; i < hum.capacity() && (~i); i += dif)
 				if(mh[i]){
-					std::vector<int> v = hum[i].get_cor();
-					obey(command[i], hum[i]);
-					teleport(hum[i]);
-					claim_chest(hum[i]);
-					command[i] = '+';
+					order.push_back(i);
+					phase[(int)commands[(unsigned char)command[i]].phase].push_back(i);
 				}
+			for(int i: phase[0])
+				obey(command[i], hum[i]);
+			for(int i: phase[1])
+				obey(command[i], hum[i]);
+			for(int i: order){
+				teleport(hum[i]);
+				claim_chest(hum[i]);
+			}
+			for(int i: phase[2])
+				obey(command[i], hum[i]);
+			for(int i: order)
+				command[i] = '+';
 			return;
 		}
 
+		// index of a command in the agent's action string (the last one if it repeats)
+		int action_of(char c){
+			if(action != action_src){
+				action_src = action;
+				std::fill(action_index, action_index + 256, 0);
+				for(int i = 0; i < (int)action.size(); ++i)
+					action_index[(unsigned char)action[i]] = i;
+			}
+			return action_index[(unsigned char)c];
+		}
+
 		void command_list(bool b = false){
 			printer.cls();
 			printer.print(head(true));
@@ -1058,7 +1505,7 @@ namespace Environment::Field{
 
 		void update_bull(){
 			int cnt = 0;
-			for(int _ = 0; _ < B; ++_)
+			for(int _ = 0; _ < bull.capacity(); ++_)
 				if(mb[_]){
 					std::vector<int> v = bull[_].get_cor();
 					int i = v[0], j = v[1], k = v[2];
@@ -1070,10 +1517,10 @@ namespace Environment::Field{
 					themap1[i][j + wdx[d]][k + wdy[d]].s[2] = 0;
 					place[cnt++] = std::vector<int>{i, j + wdx[d], k + wdy[d]};
 				}
-			int r = rand() & 1, st = (1 - r) * (B - 1), dif = 2 * r - 1;
+			int r = rand() & 1, st = (1 - r) * (bull.capacity() - 1), dif = 2 * r - 1;
 			if(r)
-				reverse(place, place + cnt);
-			for(int _ = st; _ < B && (~_); _ += dif)
+				reverse(place.begin(), place.begin() + cnt);
+			for(int _ = st; _ < bull.capacity() && (~_); _ += dif)
 				if(mb[_]){
 					std::vector<int> v = bull[_].get_cor();
 					int i = v[0], j = v[1], k = v[2];
@@ -1099,10 +1546,11 @@ namespace Environment::Field{
 			return;
 		}
 
+		template<typename P>
 		bool check_end(){
-			if(online && rivals_are_dead()){
+			if(P::online && rivals_are_dead()){
                 command[ind] = '+';
-				if(!replay_mode){
+				if constexpr(!P::replay){
 					client.send_it();
 					client.end_it();
 				}
@@ -1118,7 +1566,7 @@ namespace Environment::Field{
 				while(getch() != ' ');
 				return true;
 			}
-		    if(online && disconnect && !replay_mode){
+		    if(P::online && !P::replay && disconnect){
 				silent = false;
 				render_it();
 				if(printThread.joinable())
@@ -1129,7 +1577,7 @@ namespace Environment::Field{
 				return true;
 		    }
 			if(hum[ind].get_Hp() <= 0){
-                if(online && !replay_mode){
+                if constexpr(P::online && !P::replay){
 					command[ind] = '~';
 					client.send_it();
 					client.end_it();
@@ -1142,7 +1590,7 @@ namespace Environment::Field{
 				while(getch() != ' ');
 				return true;
 			}
-			if(mode == "Timer"){
+			if constexpr(P::kind == TIMER){
 				if(time(0) - tb >= level * 60 * 5){
 					if(kills < level * 5){
 						silent = false;
@@ -1155,7 +1603,7 @@ namespace Environment::Field{
 					}
 					else{
 						std::string s = "You won :)\n";
-						if (!using_an_agent){
+						if constexpr(!P::agent){
 							s += "reward: ";
 							s += std::to_string((int)(hum[ind].get_level_timer() == level) * level * 1000 + loot);
 							s += "$\n";
@@ -1168,7 +1616,7 @@ namespace Environment::Field{
 						if(printThread.joinable())
 							printThread.join();
 						printer.print(s);
-						if (!using_an_agent){
+						if constexpr(!P::agent){
 							hum[ind].set_money(hum[ind].get_money() + loot + (int)(hum[ind].get_level_timer() == level) * level * 1000);
 							if(hum[ind].get_level_timer() == level)
 								hum[ind].level_timer_up();
@@ -1179,9 +1627,9 @@ namespace Environment::Field{
 				}
 				return false;
 			}
-			if(level * 5 <= kills && mode == "Solo"){
+			if(P::kind == SOLO && level * 5 <= kills){
 				std::string s = "You won :)\n";
-				if (!using_an_agent){
+				if constexpr(!P::agent){
 					s += "reward: ";
 					s += std::to_string((int)(hum[ind].get_level_solo() == level) * level * 1000 + loot);
 					s += "$\n";
@@ -1194,7 +1642,7 @@ namespace Environment::Field{
 				if(printThread.joinable())
 					printThread.join();
 				printer.print(s);
-				if (!using_an_agent){
+				if constexpr(!P::agent){
 					hum[ind].set_money(hum[ind].get_money() + loot + (int)(hum[ind].get_level_solo() == level) * level * 1000);
 					if(hum[ind].get_level_solo() == level)
 						hum[ind].level_solo_up();
@@ -1202,9 +1650,9 @@ namespace Environment::Field{
 				while(getch() != ' ');
 				return true;
 			}
-			if(level * 10 <= teams_kills && rivals_are_dead() && mode == "Squad"){
+			if(P::kind == SQUAD && level * 10 <= teams_kills && rivals_are_dead()){
 				std::string s = "You won :)\n";
-				if (!using_an_agent){
+				if constexpr(!P::agent){
 					s += "reward: ";
 					s += std::to_string((int)(hum[ind].get_level_squad() == level) * level * 1000 + loot);
 					s += "$\n";
@@ -1217,7 +1665,7 @@ namespace Environment::Field{
 				if(printThread.joinable())
 					printThread.join();
 				printer.print(s);
-				if (!using_an_agent){
+				if constexpr(!P::agent){
 					hum[ind].set_money(hum[ind].get_money() + loot + (int)(hum[ind].get_level_squad() == level) * level * 1000);
 					if(hum[ind].get_level_squad() == level)
 						hum[ind].level_squad_up();
@@ -1228,56 +1676,207 @@ namespace Environment::Field{
 			return false;
 		}
 
+		// reads ./map/floor1.txt, ./map/floor2.txt, ... until a file is missing, the size of the world
+		// is taken from the files: N is the longest floor and M the widest row, missing cells are walls
+		void parse_floors(std::vector<char> &sym, std::vector<int> &link){
+			std::vector<std::vector<std::vector<std::pair<char, int>>>> floors;
+			for(int k = 1; ; ++k){
+				std::ifstream f("./map/floor" + std::to_string(k) + ".txt");
+				if(!f.is_open())
+					break;
+				floors.emplace_back();
+				for(std::string line; std::getline(f, line);){
+					std::vector<std::pair<char, int>> row;
+					for(int p = 0; p < (int)line.size(); ++p){
+						if(isspace(line[p]))
+							continue;
+						row.push_back({line[p], -1});
+						if(line[p] == '^' || line[p] == 'v'){
+							int q = p + 1;
+							while(q < (int)line.size() && isspace(line[q]))
+								++q;
+							row.back().second = std::atoi(line.c_str() + q);
+							while(q < (int)line.size() && isdigit(line[q]))
+								++q;
+							p = q - 1;
+						}
+					}
+					if(!row.empty())
+						floors.back().push_back(row);
+				}
+				f.close();
+			}
+			F = floors.size(), N = M = 0;
+			for(auto &fl: floors){
+				N = std::max(N, (int)fl.size());
+				for(auto &row: fl)
+					M = std::max(M, (int)row.size());
+			}
+			sym.assign(F * N * M, '#');
+			link.assign(F * N * M, -1);
+			for(int k = 0; k < F; ++k)
+				for(int i = 0; i < (int)floors[k].size(); ++i)
+					for(int j = 0; j < (int)floors[k][i].size(); ++j){
+						sym[(k * N + i) * M + j] = floors[k][i][j].first;
+						link[(k * N + i) * M + j] = floors[k][i][j].second;
+					}
+			return;
+		}
+
+		// ./map/world.bin holds the parsed floors, it is rebuilt when a floor file is added, removed or modified
+		// layout: magic, F, N, M, F modification times, F * N * M symbols, F * N * M stair links
+		std::vector<long long> floor_stamps(){
+			std::vector<long long> res;
+			for(int k = 1; ; ++k){
+				std::string name = "./map/floor" + std::to_string(k) + ".txt";
+				std::error_code ec;
+				auto t = std::filesystem::last_write_time(name, ec);
+				if(ec)
+					return res;
+				res.push_back(t.time_since_epoch().count());
+			}
+		}
+
+		bool read_world(const std::vector<long long> &stamps, std::vector<char> &sym, std::vector<int> &link){
+			std::ifstream f("./map/world.bin", std::ios::binary);
+			if(!f.is_open())
+				return false;
+			char magic[8];
+			int dim[3];
+			f.read(magic, 8);
+			f.read((char*)dim, sizeof dim);
+			if(!f || memcmp(magic, "SFWORLD1", 8) || dim[0] != (int)stamps.size() || dim[1] < 0 || dim[2] < 0)
+				return false;
+			std::vector<long long> st(dim[0]);
+			f.read((char*)st.data(), st.size() * sizeof(long long));
+			if(!f || st != stamps)
+				return false;
+			sym.resize((long long)dim[0] * dim[1] * dim[2]);
+			link.resize(sym.size());
+			f.read(sym.data(), sym.size());
+			f.read((char*)link.data(), link.size() * sizeof(int));
+			if(!f)
+				return false;
+			F = dim[0], N = dim[1], M = dim[2];
+			return true;
+		}
+
+		void write_world(const std::vector<long long> &stamps, const std::vector<char> &sym, const std::vector<int> &link){
+			std::ofstream f("./map/world.bin", std::ios::binary | std::ios::trunc);
+			if(!f.is_open())
+				return;
+			int dim[3] = {F, N, M};
+			f.write("SFWORLD1", 8);
+			f.write((const char*)dim, sizeof dim);
+			f.write((const char*)stamps.data(), stamps.size() * sizeof(long long));
+			f.write(sym.data(), sym.size());
+			f.write((const char*)link.data(), link.size() * sizeof(int));
+			f.close();
+			return;
+		}
+
+		// builds the pristine world once per process, every later match starts from a copy of it
+		void build_world(){
+			std::vector<char> sym;
+			std::vector<int> link;
+			std::vector<long long> stamps = floor_stamps();
+			if(!read_world(stamps, sym, link)){
+				parse_floors(sym, link);
+				write_world(stamps, sym, link);
+			}
+			CN = (N + CS - 1) / CS, CM = (M + CS - 1) / CS;
+			node wall;
+			wall.s[3] = 1;
+			pristine.resize(F, N, M, wall);
+			themap1.resize(F, N, M, nd);
+			pristine_portal.clear();
+			for(int k = 0; k < F; ++k)
+				for(int i = 0; i < N; ++i)
+					for(int j = 0; j < M; ++j){
+						node &e = pristine[k][i][j];
+						char c = sym[(k * N + i) * M + j];
+						e = nd;
+						if(c == '#')
+							e.s[3] = 1;
+						else if(c == '^'){
+							e.s[5] = 1;
+							e.portal_ind = link[(k * N + i) * M + j];
+						}
+						else if(c == 'v'){
+							e.s[6] = 1;
+							e.portal_ind = link[(k * N + i) * M + j];
+						}
+						else if(c == 'O' && (int)pristine_portal.size() < B)
+							e.s[7] = 1, pristine_portal.push_back(std::vector<int>{k, i, j});
+					}
+			return;
+		}
+
+		void load_map(){
+			if(!F)
+				build_world();
+			themap = pristine;
+			portal = pristine_portal;
+			active.assign(portal.size(), 1);
+#if defined(CHUNKED_LOD)
+			chunks.resize(F * CN * CM);
+			for(int c: live_chunks)
+				chunks[c]->zombies.clear(), chunks[c]->at = -1;
+			live_chunks.clear();
+			lod.assign(F * CN * CM, 0);
+			zlast.assign(zomb.capacity(), 0);
+#endif
+			return;
+		}
+
+		std::string footprint() const{
+			std::string res = "";
+			res += "humans:  " + std::to_string(hum.allocated()) + " / " + std::to_string(hum.capacity()) + " slots, " + std::to_string(hum.footprint() >> 10) + " KB\n";
+			res += "zombies: " + std::to_string(zomb.allocated()) + " / " + std::to_string(zomb.capacity()) + " slots, " + std::to_string(zomb.footprint() >> 10) + " KB\n";
+			res += "bullets: " + std::to_string(bull.allocated()) + " / " + std::to_string(bull.capacity()) + " slots, " + std::to_string(bull.footprint() >> 10) + " KB\n";
+			res += "map:     " + std::to_string(F) + " x " + std::to_string(N) + " x " + std::to_string(M) + " cells, " + std::to_string((long long)F * (N + 2) * (M + 2) * sizeof(node) * 3 >> 10) + " KB\n";
+			return res;
+		}
+
 		void setup(){
 			Environment::Character::me.backpack.vec = -1;
 			tb = time(nullptr);
 			loot = teams_kills = kills = frame = 0;
 			online = (mode == "AI Battle Royal" || mode == "Battle Royal");
+			if(!F)
+				build_world();
+			long long area = (long long)F * N * M;
+			for(auto &e: mode_capacity)
+				if(e.mode == mode){
+					hum.set_capacity(e.h), bull.set_capacity(e.b);
+					zomb.set_capacity(std::max<long long>(e.z, area / zombie_cells));
+					zombie_spawns = std::max<long long>(1, area / zombie_spawn_cells);
+				}
 			silent = quit = is_human = false;
 			recomZ = nullptr;
 			recomH = nullptr;
 			temp.clear();
-			for(int i = 0; i < B; ++i)
-				active[i] = mb[i] = false;
-			for(int i = 0; i < Z; ++i)
-				mz[i] = false;
-			for(int i = 0; i < H; ++i){
-				mh[i] = remote[i] = false;
-				command[i] = '+';
-				hum[i].deleteAgent();
-            }
-			for(int k = 0; k < F; ++k){
-				std::ifstream f("./map/floor" + std::to_string(k + 1) + ".txt");
-				for(int i = 0; i < N; ++i)
-					for(int j = 0; j < M; ++j){
-						themap[k][i][j] = nd;
-						char c;
-						f >> c;
-						if(c == '#')
-							themap[k][i][j].s[3] = 1;
-						else if(c == '^'){
-							themap[k][i][j].s[5] = 1;
-							f >> themap[k][i][j].portal_ind;
-						}
-						else if(c == 'v'){
-							themap[k][i][j].s[6] = 1;
-							f >> themap[k][i][j].portal_ind;
-						}
-						else if(c == 'O'){
-							themap[k][i][j].s[7] = 1;
-							int index = p_ind();
-							portal[index] = std::vector<int>{k, i, j};
-							active[index] = 1;
-						}
-					}
-				f.close();
-			}
+			mb.reset(), mz.reset(), mh.reset(), remote.reset();
+			place.resize(2 * bull.capacity());
+			memset(command, '+', sizeof command);
+			think_next.assign(hum.capacity(), 0);
+			last_command.assign(hum.capacity(), '+');
+			think_from = 0;
+			++match_epoch;
+			std::vector<Environment::Character::Human*> keep;
+			for(auto p: Environment::Character::with_agent)
+				if(hum.contains(p))
+					p->deleteAgent();
+				else if(p->get_active_agent())
+					keep.push_back(p);
+			Environment::Character::with_agent.swap(keep);
+			load_map();
 			load_data();
 			return;
 		}
 
 		void portal_damage(){
-			for(int i = 0; i < B; ++i){
+			for(int i = 0; i < (int)portal.size(); ++i){
 				if(!active[i])
 					continue;
 				std::vector<int> v = portal[i];
@@ -1301,47 +1900,33 @@ namespace Environment::Field{
 			recomH = nullptr;
 			recomZ = nullptr;
 			int mn = 1000000021;
-			for(int i = 0; i < ind; ++i)
-				if(mh[i]){
-					std::vector<int> v1 = hum[i].get_cor();
-					std::vector<int> v = hum[ind].get_cor();
-					int dist = abs(v[1] - v1[1]) + abs(v[2] - v1[2]);
-					dist += 60 * (v[0] != v1[0]) + 5 * abs(v[0] - v1[0]);
-					if(dist < mn && hum[i].get_team() != hum[ind].get_team()){
-						mn = dist;
-						is_human = true;
-						recomH = &hum[i];
-					}
-				}
-			for(int i = ind + 1; i < H; ++i)
-				if(mh[i]){
-					std::vector<int> v1 = hum[i].get_cor();
-					std::vector<int> v = hum[ind].get_cor();
-					int dist = abs(v[1] - v1[1]) + abs(v[2] - v1[2]);
-					dist += 60 * (v[0] != v1[0]) + 5 * abs(v[0] - v1[0]);
-					if(dist < mn && hum[i].get_team() != hum[ind].get_team()){
+			const auto &me_ = hum.state(ind);
+			for(int i = 0; i < hum.capacity(); ++i)
+				if(i != ind && mh[i]){
+					const auto &e = hum.state(i);
+					int dist = abs(me_.cor[1] - e.cor[1]) + abs(me_.cor[2] - e.cor[2]);
+					dist += 60 * (me_.cor[0] != e.cor[0]) + 5 * abs(me_.cor[0] - e.cor[0]);
+					if(dist < mn && e.team != me_.team){
 						mn = dist;
 						is_human = true;
 						recomH = &hum[i];
 					}
 				}
-			for(int i = 0; i < Z; ++i)
-				if(mz[i]){
-					std::vector<int> v1 = zomb[i].get_cor();
-					std::vector<int> v = hum[ind].get_cor();
-					int dist = abs(v[1] - v1[1]) + abs(v[2] - v1[2]);
-					dist += 60 * (v[0] != v1[0]) + 5 * abs(v[0] - v1[0]);
-					if(dist < mn){
-						mn = dist;
-						is_human = false;
-						recomZ = &zomb[i];
-					}
+			for(int i: mz.slots()){
+				const auto &e = zomb.state(i);
+				int dist = abs(me_.cor[1] - e.cor[1]) + abs(me_.cor[2] - e.cor[2]);
+				dist += 60 * (me_.cor[0] != e.cor[0]) + 5 * abs(me_.cor[0] - e.cor[0]);
+				if(dist < mn){
+					mn = dist;
+					is_human = false;
+					recomZ = &zomb[i];
 				}
+			}
 			return;
 		}
 
         void update_tmp(){
-        	for(int _ = 0; _ < B; ++_){
+        	for(int _ = 0; _ < bull.capacity(); ++_){
         		if(!mb[_])
         			continue;
         		std::vector<int> v = bull[_].get_cor();
@@ -1401,18 +1986,21 @@ namespace Environment::Field{
 			std::vector<int> v = temp_me.get_cor();
 			v[1] = std::max(v[1], _H), v[1] = std::min(v[1], N - _H - 1);
 			v[2] = std::max(v[2], W), v[2] = std::min(v[2], M - W - 1);
+			temp_map.resize(N * M);
 			for(int i = 0; i < N; ++i)
 				for(int j = 0; j < M; ++j){
-					temp_map[i][j] = temp_cell;
-					temp_map[i][j].s = themap[v[0]][i][j].s;
-					if(temp_map[i][j].s[0]) {
-						temp_map[i][j].team = themap[v[0]][i][j].human->get_team();
-						temp_map[i][j].way = themap[v[0]][i][j].human->get_way();
+					temp_node &e = temp_map[i * M + j];
+					const node &cell = themap[v[0]][i][j];
+					e = temp_cell;
+					e.s = cell.s;
+					if(e.s[0]) {
+						e.team = cell.human->get_team();
+						e.way = cell.human->get_way();
 					}
-					if(temp_me.get_team() == temp_map[i][j].team)
-						temp_map[i][j].iam = (themap[v[0]][i][j].human == &hum[ind]);
-					if(temp_map[i][j].s[1])
-						temp_map[i][j].super = themap[v[0]][i][j].zombie->is_super();
+					if(temp_me.get_team() == e.team)
+						e.iam = (cell.human == &hum[ind]);
+					if(e.s[1])
+						e.super = cell.zombie->is_super();
 				}
 			return;
 		}
@@ -1425,21 +2013,8 @@ namespace Environment::Field{
 			return;
 		}
 
-		void play(){
-			setup();
-			if(disconnect && online)
-				return;
-            if(online && !replay_mode)
-                client.prepare();
-			cls();
-			std::cout << "* Please keep this terminal\nwindow active while playing :)" << std::endl;
-			during_battle = true;
-			disable_input_buffering();
-			printer.start();
-			start = std::chrono::steady_clock::now();
-			view();
-			++frame, find_recom(), render_it();
-			start = std::chrono::steady_clock::now();
+		template<typename P>
+		void loop(){
 			while(true){
 				if(frame % pc <= 1)
 					spawn_chest();
@@ -1447,9 +2022,9 @@ namespace Environment::Field{
 					spawn_zombie_npc();
 				if(frame % ph <= 1)
 					spawn_human_npc();
-				if(check_end())
+				if(check_end<P>())
 					break;
-				get_my_action();
+				get_my_action<P>();
 				if(quit)
 					break;
 				zombie_action();
@@ -1461,7 +2036,7 @@ namespace Environment::Field{
 				start = std::chrono::steady_clock::now();
 				updmap();
 				update_bull();
-				human_action();
+				human_action<P>();
 				view();
 				update_tmp();
 				hit_human(), hit_zombie();
@@ -1470,12 +2045,56 @@ namespace Environment::Field{
 				updmap();
 				update_bull();
 			}
+			return;
+		}
+
+		// runs the loop compiled for this match's mode and replay / logging / agent flags
+		template<int KIND, bool... On>
+		void select_loop(const bool* features){
+			if constexpr(sizeof...(On) == 3)
+				loop<policy<KIND, On...>>();
+			else if(features[sizeof...(On)])
+				select_loop<KIND, On..., true>(features);
+			else
+				select_loop<KIND, On..., false>(features);
+			return;
+		}
+
+		void play(){
+			setup();
+			if(disconnect && online)
+				return;
+            if(online && !replay_mode)
+                client.prepare();
+			cls();
+			std::cout << "* Please keep this terminal\nwindow active while playing :)" << std::endl;
+			during_battle = true;
+			disable_input_buffering();
+			printer.start();
+			start = std::chrono::steady_clock::now();
+			view();
+			++frame, find_recom(), render_it();
+			start = std::chrono::steady_clock::now();
+			bool features[3] = {replay_mode, enable_logging, using_an_agent};
+			if(online)
+				select_loop<ONLINE>(features);
+			else if(mode == "Timer")
+				select_loop<TIMER>(features);
+			else if(mode == "Solo")
+				select_loop<SOLO>(features);
+			else
+				select_loop<SQUAD>(features);
 			during_battle = false;
 			view();
 			printer.stop();
 			restore_input_buffering();
 			hum[ind].deleteAgent();
 			hum[ind].reset();
+			Agent::end_match();
+
+			#if defined(REPORT_FOOTPRINT)
+			std::cout << footprint();
+			#endif
 
 			if(replay_mode) {
 				replay_file.close();
@@ -1921,6 +2540,7 @@ namespace Environment::Field{
 		Environment::Character::me.reset_agent_active();
 		if(using_an_agent)
 			manual = true;
+		count_alive();
 		return;
 	}
 
@@ -2023,8 +2643,8 @@ namespace Environment::Field{
 		Hight = _H;
 		#endif
 		for(int i = v[1] - Hight; i <= v[1] + Hight; ++i, res.push_back('\n'))
-			for(int j = v[2] - Width; j <= v[2] + Width; ++j){
-				cell = ((i < 0 || i >= N || j < 0 || j >= M) ? temp_cell.showit() : temp_map[i][j].showit());
+			for(int j = v[2] - Width, in = (0 <= i && i < N); j <= v[2] + Width; ++j){
+				cell = ((!in || j < 0 || j >= M) ? temp_cell.showit() : temp_map[i * M + j].showit());
 				color = "";
 				int cnt = 2;
 				for(int k = 0; k < cell.size(); ++k){
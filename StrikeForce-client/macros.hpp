@@ -15,6 +15,18 @@
 
 #define HIGHLY_OPTIMIZED
 
+//#define CHUNKED_LOD
+
+//#define DECISION_SCHEDULER
+
+#define FUSED_POLICY
+
+//#define QUANTIZED_POLICY
+
+//#define INFERENCE_ONLY
+
+//#define REPORT_FOOTPRINT
+
 #define SLOWMOTION
 
 #define DATASET "datasets/bot-0.5(0)"
\ No newline at end of file
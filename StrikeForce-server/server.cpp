@@ -33,6 +33,10 @@ SOFTWARE.
 #include <unistd.h>
 #include <time.h>
 #include <execution>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
 
 #if defined(__unix__) || defined(__APPLE__)
 #include <arpa/inet.h>
@@ -57,7 +61,20 @@ std::vector<char> command;
 std::vector<std::ofstream> actions;
 std::ofstream match_log;
 
-int n, m, cnt;
+int n, m;
+
+// alive players per team, updated when a player leaves so result() never rescans the players
+std::unique_ptr<std::atomic<int>[]> team_alive;
+std::atomic<int> cnt, teams_left, teams_sum;
+std::vector<int> announced;
+std::mutex announced_lock;
+
+void eliminate(int i){
+	--cnt;
+	if(--team_alive[team[i]] == 0)
+		--teams_left, teams_sum -= team[i];
+	return;
+}
 
 void my_recv(int sock, char* buffer, int i){
 	while(true){
@@ -81,6 +98,7 @@ void rcv_commands(){
 			sscanf(buffer, "%c", &command[i]);
 			if(command[i] == '_' || command[i] == '~' || disconnect[i]){
 				alive[i] = false, close(clients[i]);
+				eliminate(i);
 #ifdef LOGGING
 				match_log << "player with index " << i << " from team " << team[i] << " ";
 				match_log << (command[i] == '_' ? (disconnect[i] ? "disconnected" : "quited") : "eleminated") << '\n';
@@ -88,8 +106,11 @@ void rcv_commands(){
 #endif
                 std::cout << "player with index " << i << " from team " << team[i] << " ";
 				std::cout << (command[i] == '_' ? (disconnect[i] ? "disconnected" : "quited") : "eleminated") << '\n';
-				if(command[i] == '_')
+				if(command[i] == '_'){
 					announce[i] = true;
+					std::lock_guard<std::mutex> lock(announced_lock);
+					announced.push_back(i);
+				}
 			}
 #ifdef LOGGING
 			actions[i] << command[i];
@@ -117,18 +138,11 @@ void send_commands(){
 }
 
 int result(){
-    int winner = 0, num = 0;
-	cnt = 0;
-    for(int i = 0; i < n; ++i)
-        if(alive[i]){
-		 	if(team[i] != winner)
-            	++num, winner = team[i];
-			++cnt;
-		}
-		else
-			announce[i] = false;
-    if(num == 1)
-        return winner;
+	for(int i: announced)
+		announce[i] = false;
+	announced.clear();
+    if(teams_left == 1)
+        return teams_sum;
     return 0;
 }
 
@@ -177,7 +191,11 @@ int main(){
 		team.push_back(num);
 		indices.push_back(i);
 	}
-	cnt = n;
+	cnt = n, teams_left = teams_sum = 0;
+	team_alive = std::make_unique<std::atomic<int>[]>((team.empty() ? 0 : *std::max_element(team.begin(), team.end())) + 1);
+	for(int i = 0; i < n; ++i)
+		if(team_alive[team[i]]++ == 0)
+			++teams_left, teams_sum += team[i];
 	command.assign(n, '+');
 	alive.assign(n, true);
 	disconnect.assign(n, false);